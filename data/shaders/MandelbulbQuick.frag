@@ -13,6 +13,16 @@
  *      1.0.4   - Fixed issue with older graphic cards and the specular highlights
  *      1.0.4-1 - (fork) Moved rotation matrix code out of shader, added fov controls.
  *                Andrew Caudwell (acaudwell@gmail.com)
+ *      1.0.4-2 - (fork) Feature flags are compile time #defines (JULIA, PHONG,
+ *                RADIOLARIA, SHADOWS, PULSE, RAVE, BACKGROUND_GRADIENT,
+ *                ANTIALIASING, INTEGER_POWER) set by the viewer for each
+ *                combination in use, so unused branches are compiled out.
+ *      1.0.4-3 - (fork) Split renderPixel into marchPixel and shadePixel.
+ *                GBUFFER_PASS writes the march results to float render
+ *                targets and LIGHTING_PASS shades them, so colour changes
+ *                don't need the fractal to be marched again.
+ *      1.0.4-4 - (fork) PROGRESSIVE renders one sample per pixel offset by
+ *                jitter, for the viewer to average while the view is still.
  *
  * Copyright (c) 2009 Tom Beddard
  * http://www.subblue.com
@@ -56,6 +66,7 @@ uniform float ambientOcclusionEmphasis;
 uniform float bounding;
 uniform float bailout;
 uniform float power;
+uniform int   intPower;
 uniform vec3  julia_c;
 uniform vec3  camera;
 uniform vec3  cameraFine;
@@ -90,10 +101,16 @@ uniform mat3 objRotation;
 
 uniform bool backgroundGradient;
 uniform float fov;
+uniform vec2 jitter;
 #define PI 3.141592653
 #define MIN_EPSILON 3e-7
 
 uniform sampler2D texture;
+
+// G-buffer written by GBUFFER_PASS and read by LIGHTING_PASS
+uniform sampler2D gbuffer0;	// position, ray length
+uniform sampler2D gbuffer1;	// normal, shadowed
+uniform sampler2D gbuffer2;	// min_dist, steps, hit, bounded
 varying vec3 Position;
 
 vec2 texelSize = vec2(1.0/width, 1.0/height);
@@ -130,6 +147,52 @@ void powN(inout vec3 z, float zr0, inout float dr)
     z = zr * vec3(czo*cos(zi), czo*sin(zi), -sin(zo));
 }
 
+vec2 complexMul(vec2 a, vec2 b)
+{
+	return vec2(a.x*b.x - a.y*b.y, a.x*b.y + a.y*b.x);
+}
+
+// Trig free version of powN for whole number powers (intPower > 0).
+//
+// cos/sin of the multiplied angles are the real/imaginary parts of the
+// unit complex numbers (x + iy)/|xy| and (|xy| + iz)/r raised to the
+// power, which only needs multiplication by repeated squaring.
+void powNInteger(inout vec3 z, float zr0, inout float dr)
+{
+	float rho = length(z.xy);
+
+	vec2 phi   = rho > 0.0 ? z.xy / rho : vec2(1.0, 0.0);
+	vec2 theta = zr0 > 0.0 ? vec2(rho, z.z) / zr0 : vec2(1.0, 0.0);
+
+	// phi, theta and zr0 to the power of intPower-1
+	vec2 phiN   = vec2(1.0, 0.0);
+	vec2 thetaN = vec2(1.0, 0.0);
+	float zr    = 1.0;
+
+	vec2 phiP   = phi;
+	vec2 thetaP = theta;
+	float zrP   = zr0;
+
+	for (int e = intPower - 1; e > 0; e /= 2) {
+		if (e - 2 * (e / 2) == 1) {
+			phiN   = complexMul(phiN, phiP);
+			thetaN = complexMul(thetaN, thetaP);
+			zr    *= zrP;
+		}
+		phiP   = complexMul(phiP, phiP);
+		thetaP = complexMul(thetaP, thetaP);
+		zrP   *= zrP;
+	}
+
+	phiN   = complexMul(phiN, phi);
+	thetaN = complexMul(thetaN, theta);
+
+	dr = zr * dr * power + 1.0;
+	zr *= zr0;
+
+	z = zr * vec3(thetaN.x*phiN.x, thetaN.x*phiN.y, -thetaN.y);
+}
+
 // The fractal calculation
 //
 // Calculate the closest distance to the fractal boundary and use this
@@ -146,7 +209,11 @@ void powN(inout vec3 z, float zr0, inout float dr)
 //
 float DE(vec3 z0, inout float min_dist)
 {
-	vec3 c = julia ? julia_c : z0; // Julia set has fixed c, Mandelbrot c changes with location
+#ifdef JULIA
+	vec3 c = julia_c; // Julia set has fixed c, Mandelbrot c changes with location
+#else
+	vec3 c = z0;
+#endif
 	vec3 z = z0;
 
 	float dr = 1.0;
@@ -154,13 +221,20 @@ float DE(vec3 z0, inout float min_dist)
 	if (r < min_dist) min_dist = r;
 
 	for (int n = 0; n < maxIterations; n++) {
+#ifdef INTEGER_POWER
+		powNInteger(z, r, dr);
+#else
 		powN(z, r, dr);
+#endif
 
 		z += c;
+#ifdef PULSE
         if(Pulse>0.0) z *= sin(Pulse*0.5+0.5)*PulseScale;
+#endif
 
-		if (radiolaria && z.y > radiolariaFactor) z.y = radiolariaFactor;
-
+#ifdef RADIOLARIA
+		if (z.y > radiolariaFactor) z.y = radiolariaFactor;
+#endif
 
 		r = length(z);
 		if (r < min_dist) min_dist = r;
@@ -284,148 +358,238 @@ vec3 rayDirection(vec2 p)
 }
 
 
-// Calculate the output colour for each input pixel
-vec4 renderPixel(vec2 pixel)
+// What the ray march found for one pixel. This is all the lighting needs,
+// so the deferred path stores it in a G-buffer and shades it separately.
+struct Surface {
+	bool  bounded;		// ray entered the bounding sphere
+	bool  hit;			// ray reached the fractal
+	vec3  position;		// where the ray stopped
+	vec3  normal;
+	float ray_length;
+	float min_dist;
+	float steps;		// number of marching steps taken
+	float shadowed;		// 1.0 if the light is blocked
+};
+
+
+// March the ray for a pixel
+Surface marchPixel(vec2 pixel)
 {
+	Surface s;
 	float tmin, tmax;
 	vec3 ray_direction = rayDirection(pixel);
-	vec4 pixel_color = backgroundColor;
 
-    float aoScale = aoSteps / epsilonScale;
+	s.bounded    = intersectBoundingSphere(eye, ray_direction, tmin, tmax);
+	s.hit        = false;
+	s.position   = eye;
+	s.normal     = vec3(0);
+	s.ray_length = 0.0;
+	s.min_dist   = 4.0;
+	s.steps      = 0.0;
+	s.shadowed   = 0.0;
 
-	if(intersectBoundingSphere(eye, ray_direction, tmin, tmax)) {
+	if(!s.bounded) return s;
 
-        vec3 ray = eye + tmin * ray_direction;
+    vec3 ray = eye + tmin * ray_direction;
 
-        float dist, ao;
-        float min_dist = 4.0;
-        float ray_length = tmin;
-        float eps = MIN_EPSILON;
+    float dist;
+    float min_dist = 4.0;
+    float ray_length = tmin;
+    float eps = MIN_EPSILON;
 
-        // number of raymarching steps scales inversely with factor
-        int max_steps = int(float(stepLimit) / epsilonScale);
+    // number of raymarching steps scales inversely with factor
+    int max_steps = int(float(stepLimit) / epsilonScale);
 
-        int i;
-        float f;
+    int i;
+    float f;
 
-        for (i = 0; i < max_steps; ++i) {
-            dist = DE(ray, min_dist);
+    for (i = 0; i < max_steps; ++i) {
+        dist = DE(ray, min_dist);
 
-            // March ray forward
-            f = epsilonScale * dist;
-            ray += f * ray_direction;
-            ray_length += f;
+        // March ray forward
+        f = epsilonScale * dist;
+        ray += f * ray_direction;
+        ray_length += f;
 
-            // Are we within the intersection threshold or completely missed the fractal
-            if (dist < eps || ray_length > tmax) {
-                break;
-            }
-
-            // Set the intersection threshold as a function of the ray length away from the camera
-            //eps = max(max(MIN_EPSILON, eps_start), pixel_scale * pow(ray_length, epsilonScale));
-            eps = max(MIN_EPSILON, pixel_scale * ray_length);
+        // Are we within the intersection threshold or completely missed the fractal
+        if (dist < eps || ray_length > tmax) {
+            break;
         }
 
+        // Set the intersection threshold as a function of the ray length away from the camera
+        //eps = max(max(MIN_EPSILON, eps_start), pixel_scale * pow(ray_length, epsilonScale));
+        eps = max(MIN_EPSILON, pixel_scale * ray_length);
+    }
+
+    s.position   = ray;
+    s.ray_length = ray_length;
+    s.min_dist   = min_dist;
+    s.steps      = float(i);
 
-        ao	= 1.0 - clamp(1.0 - min_dist * min_dist, 0.0, 1.0) * ambientOcclusion;
+    // Found intersection?
+    if (dist < eps) {
+        s.hit = true;
 
-        // Found intersection?
-        if (dist < eps) {
+#ifdef PHONG
+        s.normal = estimate_normal(ray, eps/2.0);
 
-            if (phong) {
-                vec3 normal = estimate_normal(ray, eps/2.0);
-                float specular = 0.0;
-                pixel_color.rgb = Phong(ray, normal, specular);
+#ifdef SHADOWS
+        // The shadow ray will start at the intersection point and go
+        // towards the point light. We initially move the ray origin
+        // a little bit along this direction so that we don't mistakenly
+        // find an intersection with the same point again.
+        vec3 light_direction = normalize((light - ray) * objRotation);
+        ray += s.normal * eps * 2.0;
 
-                if (shadows > 0.0) {
-                    // The shadow ray will start at the intersection point and go
-                    // towards the point light. We initially move the ray origin
-                    // a little bit along this direction so that we don't mistakenly
-                    // find an intersection with the same point again.
-                    vec3 light_direction = normalize((light - ray) * objRotation);
-                    ray += normal * eps * 2.0;
+        float min_dist2;
+        dist = 4.0;
 
-                    float min_dist2;
-                    dist = 4.0;
+        for (int j = 0; j < max_steps; ++j) {
+            dist = DE(ray, min_dist2);
 
-                    for (int j = 0; j < max_steps; ++j) {
-                        dist = DE(ray, min_dist2);
+            // March ray forward
+            f = epsilonScale * dist;
+            ray += f * light_direction;
 
-                        // March ray forward
-                        f = epsilonScale * dist;
-                        ray += f * light_direction;
+            // Are we within the intersection threshold or completely missed the fractal
+            if (dist < eps || dot(ray, ray) > bounding * bounding) break;
+        }
 
-                        // Are we within the intersection threshold or completely missed the fractal
-                        if (dist < eps || dot(ray, ray) > bounding * bounding) break;
-                    }
+        // Again, if our estimate of the distance to the set is small, we say
+        // that there was a hit and so the source point must be in shadow.
+        if (dist < eps) s.shadowed = 1.0;
+#endif
+#endif
+    }
 
-                    // Again, if our estimate of the distance to the set is small, we say
-                    // that there was a hit and so the source point must be in shadow.
-                    if (dist < eps) {
-                        pixel_color.rgb *= 1.0 - shadows;
-                    } else {
-                        // Only add specular component when there is no shadow
-                        pixel_color.rgb += specular;
-                    }
-                } else {
-                    pixel_color.rgb += specular;
-                }
-            } else {
-                // Just use the base colour
-                pixel_color.rgb = diffuseColor.rgb;
-            }
+	return s;
+}
 
-            ao *= 1.0 - min(1.0, float(i) / aoScale) * ambientOcclusionEmphasis * 2.0;
 
-            pixel_color.rgb *= ao;
-            pixel_color.a = 1.0;
+// Calculate the colour of a marched pixel
+vec4 shadePixel(Surface s)
+{
+	vec4 pixel_color = backgroundColor;
 
-        } else {
-            if(backgroundGradient) {
-                pixel_color.rgb = backgroundColor.rgb * (1.0-min(1.0, float(i) / aoScale));
-                pixel_color.a = backgroundColor.a;
-            }
-        }
+	if(!s.bounded) return pixel_color;
 
-        if(fogDistance>0.0) {
-            float fog_alpha = min(ray_length*ray_length,fogDistance)/fogDistance;
-            pixel_color.rgb = backgroundColor.xyz * fog_alpha + pixel_color.rgb * (1.0 - fog_alpha);
-        }
+    float aoScale = aoSteps / epsilonScale;
+
+    float ao = 1.0 - clamp(1.0 - s.min_dist * s.min_dist, 0.0, 1.0) * ambientOcclusion;
 
-        if(glowDepth>0.0) {
-            float glow_alpha = min(min_dist,glowDepth)/glowDepth;
-            if(Rave) glow_alpha += ao;
+    if (s.hit) {
 
-            glow_alpha*=glow_alpha;
+#ifdef PHONG
+        float specular = 0.0;
+        pixel_color.rgb = Phong(s.position, s.normal, specular);
 
-            //colour distance from centre
-            pixel_color.rgb = pixel_color.rgb * glow_alpha + glowMulti * glowColour.xyz * (1.0-glow_alpha);
+#ifdef SHADOWS
+        if (s.shadowed > 0.5) {
+            pixel_color.rgb *= 1.0 - shadows;
+        } else {
+            // Only add specular component when there is no shadow
+            pixel_color.rgb += specular;
         }
+#else
+        pixel_color.rgb += specular;
+#endif
+#else
+        // Just use the base colour
+        pixel_color.rgb = diffuseColor.rgb;
+#endif
+
+        ao *= 1.0 - min(1.0, s.steps / aoScale) * ambientOcclusionEmphasis * 2.0;
+
+        pixel_color.rgb *= ao;
+        pixel_color.a = 1.0;
+
+    } else {
+#ifdef BACKGROUND_GRADIENT
+        pixel_color.rgb = backgroundColor.rgb * (1.0-min(1.0, s.steps / aoScale));
+        pixel_color.a = backgroundColor.a;
+#endif
+    }
+
+    if(fogDistance>0.0) {
+        float fog_alpha = min(s.ray_length*s.ray_length,fogDistance)/fogDistance;
+        pixel_color.rgb = backgroundColor.xyz * fog_alpha + pixel_color.rgb * (1.0 - fog_alpha);
+    }
+
+    if(glowDepth>0.0) {
+        float glow_alpha = min(s.min_dist,glowDepth)/glowDepth;
+#ifdef RAVE
+        glow_alpha += ao;
+#endif
+
+        glow_alpha*=glow_alpha;
+
+        //colour distance from centre
+        pixel_color.rgb = pixel_color.rgb * glow_alpha + glowMulti * glowColour.xyz * (1.0-glow_alpha);
+    }
 
+	return pixel_color;
+}
 
-	}
 
-	return pixel_color;
+// Calculate the output colour for each input pixel
+vec4 renderPixel(vec2 pixel)
+{
+	return shadePixel(marchPixel(pixel));
 }
 
 
 // The main loop
 void main()
 {
-	vec4 c = vec4(0, 0, 0, 1.0);
 	vec2 p = vec2(Position);// * size;
 
-	if (antialiasing > 0) {
-		// Average detailSuperSample^2 points per pixel
-		for (float i = 0.0; i < 1.0; i += sampleStep)
-			for (float j = 0.0; j < 1.0; j += sampleStep)
-				c += sampleContribution * renderPixel(p + vec2(i, j) * texelSize);
-	} else {
-		c = renderPixel(p);
-	}
+#if defined(GBUFFER_PASS)
+	// Store the march results for LIGHTING_PASS
+	Surface s = marchPixel(p);
+
+	gl_FragData[0] = vec4(s.position, s.ray_length);
+	gl_FragData[1] = vec4(s.normal, s.shadowed);
+	gl_FragData[2] = vec4(s.min_dist, s.steps, s.hit ? 1.0 : 0.0, s.bounded ? 1.0 : 0.0);
+
+#elif defined(LIGHTING_PASS)
+	// Shade the march results of the last GBUFFER_PASS
+	vec2 uv = gl_FragCoord.xy * texelSize;
+
+	vec4 g0 = texture2D(gbuffer0, uv);
+	vec4 g1 = texture2D(gbuffer1, uv);
+	vec4 g2 = texture2D(gbuffer2, uv);
+
+	Surface s;
+	s.position   = g0.xyz;
+	s.ray_length = g0.w;
+	s.normal     = g1.xyz;
+	s.shadowed   = g1.w;
+	s.min_dist   = g2.x;
+	s.steps      = g2.y;
+	s.hit        = g2.z > 0.5;
+	s.bounded    = g2.w > 0.5;
+
+	gl_FragColor = shadePixel(s);
+
+#else
+	vec4 c = vec4(0, 0, 0, 1.0);
+
+#if defined(PROGRESSIVE)
+	// One sample per frame, jitter is the offset in pixels within the pixel
+	// and a pixel is 2.0 * texelSize wide
+	c = renderPixel(p + jitter * 2.0 * texelSize);
+#elif defined(ANTIALIASING)
+	// Average detailSuperSample^2 points per pixel
+	for (float i = 0.0; i < 1.0; i += sampleStep)
+		for (float j = 0.0; j < 1.0; j += sampleStep)
+			c += sampleContribution * renderPixel(p + vec2(i, j) * texelSize);
+#else
+	c = renderPixel(p);
+#endif
 
 	//if (c.a <= 0.0) discard;
 
 	// Return the final color which is still the background color if we didn't hit anything.
 	gl_FragColor = c;
+#endif
 }
@@ -0,0 +1,315 @@
+/*
+    Copyright (C) 2010 Andrew Caudwell (acaudwell@gmail.com)
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version
+    3 of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "camera_spline.h"
+
+#include <algorithm>
+#include <cmath>
+
+// quatf
+
+quatf::quatf() : w(1.0f), x(0.0f), y(0.0f), z(0.0f) {
+}
+
+quatf::quatf(float w, float x, float y, float z) : w(w), x(x), y(y), z(z) {
+}
+
+quatf quatf::fromMatrix(const mat3f& m) {
+
+    const float (*r)[3] = m.matrix;
+
+    float trace = r[0][0] + r[1][1] + r[2][2];
+
+    quatf q;
+
+    //divide by the largest component to stay accurate
+    if(trace > 0.0f) {
+        float s = sqrtf(trace + 1.0f) * 2.0f;
+        q = quatf(0.25f * s, (r[2][1] - r[1][2]) / s, (r[0][2] - r[2][0]) / s, (r[1][0] - r[0][1]) / s);
+    } else if(r[0][0] > r[1][1] && r[0][0] > r[2][2]) {
+        float s = sqrtf(1.0f + r[0][0] - r[1][1] - r[2][2]) * 2.0f;
+        q = quatf((r[2][1] - r[1][2]) / s, 0.25f * s, (r[0][1] + r[1][0]) / s, (r[0][2] + r[2][0]) / s);
+    } else if(r[1][1] > r[2][2]) {
+        float s = sqrtf(1.0f + r[1][1] - r[0][0] - r[2][2]) * 2.0f;
+        q = quatf((r[0][2] - r[2][0]) / s, (r[0][1] + r[1][0]) / s, 0.25f * s, (r[1][2] + r[2][1]) / s);
+    } else {
+        float s = sqrtf(1.0f + r[2][2] - r[0][0] - r[1][1]) * 2.0f;
+        q = quatf((r[1][0] - r[0][1]) / s, (r[0][2] + r[2][0]) / s, (r[1][2] + r[2][1]) / s, 0.25f * s);
+    }
+
+    return q.normal();
+}
+
+mat3f quatf::toMatrix() const {
+    return mat3f( 1.0f - 2.0f*(y*y + z*z), 2.0f*(x*y - w*z),        2.0f*(x*z + w*y),
+                  2.0f*(x*y + w*z),        1.0f - 2.0f*(x*x + z*z), 2.0f*(y*z - w*x),
+                  2.0f*(x*z - w*y),        2.0f*(y*z + w*x),        1.0f - 2.0f*(x*x + y*y) );
+}
+
+float quatf::dot(const quatf& q) const {
+    return w*q.w + x*q.x + y*q.y + z*q.z;
+}
+
+quatf quatf::normal() const {
+    float length = sqrtf(dot(*this));
+
+    if(length <= 0.0f) return quatf();
+
+    return quatf(w / length, x / length, y / length, z / length);
+}
+
+quatf quatf::inverse() const {
+    return quatf(w, -x, -y, -z);
+}
+
+quatf quatf::operator*(const quatf& q) const {
+    return quatf( w*q.w - x*q.x - y*q.y - z*q.z,
+                  w*q.x + x*q.w + y*q.z - z*q.y,
+                  w*q.y - x*q.z + y*q.w + z*q.x,
+                  w*q.z + x*q.y - y*q.x + z*q.w );
+}
+
+quatf quatf::operator-() const {
+    return quatf(-w, -x, -y, -z);
+}
+
+quatf quatf::log() const {
+    float v = sqrtf(x*x + y*y + z*z);
+
+    if(v < 1e-6f) return quatf(0.0f, x, y, z);
+
+    float angle = atan2f(v, w) / v;
+
+    return quatf(0.0f, x * angle, y * angle, z * angle);
+}
+
+quatf quatf::exp() const {
+    float angle = sqrtf(x*x + y*y + z*z);
+
+    if(angle < 1e-6f) return quatf(cosf(angle), x, y, z).normal();
+
+    float s = sinf(angle) / angle;
+
+    return quatf(cosf(angle), x * s, y * s, z * s);
+}
+
+quatf quatf::slerp(const quatf& a, const quatf& b, float t) {
+
+    quatf to = b;
+    float cos_angle = a.dot(b);
+
+    //go the short way round
+    if(cos_angle < 0.0f) {
+        to = -b;
+        cos_angle = -cos_angle;
+    }
+
+    float wa, wb;
+
+    if(cos_angle > 0.9995f) {
+        wa = 1.0f - t;
+        wb = t;
+    } else {
+        float angle = acosf(cos_angle);
+        float s     = sinf(angle);
+
+        wa = sinf((1.0f - t) * angle) / s;
+        wb = sinf(t * angle) / s;
+    }
+
+    return quatf(a.w*wa + to.w*wb, a.x*wa + to.x*wb, a.y*wa + to.y*wb, a.z*wa + to.z*wb).normal();
+}
+
+quatf quatf::squad(const quatf& a, const quatf& b, const quatf& sa, const quatf& sb, float t) {
+    return slerp(slerp(a, b, t), slerp(sa, sb, t), 2.0f * t * (1.0f - t));
+}
+
+// CameraSpline
+
+CameraSpline::CameraSpline() {
+}
+
+void CameraSpline::build(const std::vector<vec3f>& points, const std::vector<quatf>& rotations) {
+
+    this->points.clear();
+    this->rotations.clear();
+    controls.clear();
+    arc_length.clear();
+
+    int count = points.size();
+
+    for(int i = 0; i < count; i++) {
+        quatf q = rotations[i];
+
+        //keep neighbouring rotations in the same hemisphere
+        if(i > 0 && q.dot(this->rotations[i-1]) < 0.0f) q = -q;
+
+        this->points.push_back(points[i]);
+        this->rotations.push_back(q);
+    }
+
+    controls = this->rotations;
+
+    for(int i = 1; i < count - 1; i++) {
+        updateControl(i);
+    }
+
+    arc_length.assign(getSegmentCount() * (CAMERA_SPLINE_LUT_SIZE + 1), 0.0f);
+
+    for(int s = 0; s < getSegmentCount(); s++) {
+        updateArcLength(s);
+    }
+}
+
+// adding a point only changes the control of the point before it and the
+// length of the segment before that (whose end neighbour was a reflection)
+
+void CameraSpline::append(const vec3f& point, const quatf& rotation) {
+
+    quatf q = rotation;
+
+    //keep neighbouring rotations in the same hemisphere
+    if(!rotations.empty() && q.dot(rotations.back()) < 0.0f) q = -q;
+
+    points.push_back(point);
+    rotations.push_back(q);
+    controls.push_back(q);
+
+    int count = points.size();
+
+    if(count > 2) updateControl(count - 2);
+
+    arc_length.resize(getSegmentCount() * (CAMERA_SPLINE_LUT_SIZE + 1), 0.0f);
+
+    for(int s = std::max(0, count - 3); s < getSegmentCount(); s++) {
+        updateArcLength(s);
+    }
+}
+
+void CameraSpline::removeLast() {
+
+    if(points.empty()) return;
+
+    points.pop_back();
+    rotations.pop_back();
+    controls.pop_back();
+
+    int count = points.size();
+
+    //the new last point is an end, which has no control
+    if(count > 0) controls[count-1] = rotations[count-1];
+
+    arc_length.resize(getSegmentCount() * (CAMERA_SPLINE_LUT_SIZE + 1));
+
+    if(count > 1) updateArcLength(count - 2);
+}
+
+// squad control point of an inner point, the ends have none
+
+void CameraSpline::updateControl(int index) {
+    const quatf& q   = rotations[index];
+    quatf inv        = q.inverse();
+    quatf to_next    = (inv * rotations[index+1]).log();
+    quatf to_prev    = (inv * rotations[index-1]).log();
+
+    quatf tangent(0.0f, -(to_next.x + to_prev.x) * 0.25f, -(to_next.y + to_prev.y) * 0.25f, -(to_next.z + to_prev.z) * 0.25f);
+
+    controls[index] = (q * tangent.exp()).normal();
+}
+
+void CameraSpline::updateArcLength(int segment) {
+    float* table = &arc_length[segment * (CAMERA_SPLINE_LUT_SIZE + 1)];
+
+    table[0] = 0.0f;
+
+    vec3f last = curvePoint(segment, 0.0f);
+
+    for(int i = 1; i <= CAMERA_SPLINE_LUT_SIZE; i++) {
+        vec3f point = curvePoint(segment, (float) i / CAMERA_SPLINE_LUT_SIZE);
+
+        table[i] = table[i-1] + (point - last).length();
+        last = point;
+    }
+}
+
+int CameraSpline::getSegmentCount() const {
+    return std::max(0, (int) points.size() - 1);
+}
+
+float CameraSpline::getLength(int segment) const {
+    return arc_length[segment * (CAMERA_SPLINE_LUT_SIZE + 1) + CAMERA_SPLINE_LUT_SIZE];
+}
+
+// point u of the way along the segment by its parameter (Barry and Goldman's
+// pyramidal form of Catmull-Rom, with knots spaced by the square root of distance)
+
+vec3f CameraSpline::curvePoint(int segment, float u) const {
+
+    int last = points.size() - 1;
+
+    vec3f p1 = points[segment];
+    vec3f p2 = points[segment+1];
+
+    //reflect the neighbours at the ends of the path
+    vec3f p0 = segment > 0        ? points[segment-1] : p1 * 2.0f - p2;
+    vec3f p3 = segment + 2 <= last ? points[segment+2] : p2 * 2.0f - p1;
+
+    float t1 = std::max(1e-4f, sqrtf((p1 - p0).length()));
+    float t2 = std::max(1e-4f, sqrtf((p2 - p1).length())) + t1;
+    float t3 = std::max(1e-4f, sqrtf((p3 - p2).length())) + t2;
+
+    float t = t1 + (t2 - t1) * u;
+
+    vec3f a1 = p0 * ((t1 - t) / t1)        + p1 * (t / t1);
+    vec3f a2 = p1 * ((t2 - t) / (t2 - t1)) + p2 * ((t - t1) / (t2 - t1));
+    vec3f a3 = p2 * ((t3 - t) / (t3 - t2)) + p3 * ((t - t2) / (t3 - t2));
+
+    vec3f b1 = a1 * ((t2 - t) / t2)        + a2 * (t / t2);
+    vec3f b2 = a2 * ((t3 - t) / (t3 - t1)) + a3 * ((t - t1) / (t3 - t1));
+
+    return b1 * ((t2 - t) / (t2 - t1)) + b2 * ((t - t1) / (t2 - t1));
+}
+
+// the parameter of the point a fraction s of the segment's length along it
+
+float CameraSpline::segmentParameter(int segment, float s) const {
+
+    const float* table = &arc_length[segment * (CAMERA_SPLINE_LUT_SIZE + 1)];
+
+    float length = table[CAMERA_SPLINE_LUT_SIZE];
+
+    if(length <= 0.0f) return s;
+
+    float target = s * length;
+
+    int i = std::upper_bound(table, table + CAMERA_SPLINE_LUT_SIZE + 1, target) - table;
+
+    i = std::max(1, std::min(CAMERA_SPLINE_LUT_SIZE, i));
+
+    float span = table[i] - table[i-1];
+    float frac = span > 0.0f ? (target - table[i-1]) / span : 0.0f;
+
+    return (i - 1 + frac) / CAMERA_SPLINE_LUT_SIZE;
+}
+
+void CameraSpline::evaluate(int segment, float s, vec3f& pos, quatf& rotation) const {
+
+    s = std::max(0.0f, std::min(1.0f, s));
+
+    pos = curvePoint(segment, segmentParameter(segment, s));
+
+    rotation = quatf::squad(rotations[segment], rotations[segment+1], controls[segment], controls[segment+1], s);
+}
@@ -0,0 +1,95 @@
+/*
+    Copyright (C) 2010 Andrew Caudwell (acaudwell@gmail.com)
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version
+    3 of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef MANDELBULB_CAMERA_SPLINE_H
+#define MANDELBULB_CAMERA_SPLINE_H
+
+#include "core/matrix.h"
+
+#include <vector>
+
+#define CAMERA_SPLINE_LUT_SIZE 32
+
+// unit quaternion for camera orientations
+
+class quatf {
+public:
+    float w, x, y, z;
+
+    quatf();
+    quatf(float w, float x, float y, float z);
+
+    // from a rotation matrix with the basis vectors as columns
+    static quatf fromMatrix(const mat3f& m);
+    mat3f toMatrix() const;
+
+    float dot(const quatf& q) const;
+    quatf normal() const;
+    quatf inverse() const;
+
+    quatf operator*(const quatf& q) const;
+    quatf operator-() const;
+
+    quatf log() const;
+    quatf exp() const;
+
+    static quatf slerp(const quatf& a, const quatf& b, float t);
+    static quatf squad(const quatf& a, const quatf& b, const quatf& sa, const quatf& sb, float t);
+};
+
+// A smooth curve through a list of camera positions and orientations.
+//
+// Positions follow a centripetal Catmull-Rom spline, which unlike the
+// uniform one never overshoots into loops or cusps when waypoints are
+// unevenly spaced. Orientations are interpolated with squad (spherical
+// cubic interpolation of quaternions) so the rotation changes smoothly
+// through each waypoint instead of turning abruptly at it.
+//
+// The arc length of each segment is sampled into a table, letting
+// evaluate() move along a segment at constant speed.
+
+class CameraSpline {
+    std::vector<vec3f> points;
+    std::vector<quatf> rotations;
+    std::vector<quatf> controls;
+
+    //cumulative length at CAMERA_SPLINE_LUT_SIZE+1 points of each segment
+    std::vector<float> arc_length;
+
+    vec3f curvePoint(int segment, float u) const;
+    float segmentParameter(int segment, float s) const;
+
+    void updateControl(int index);
+    void updateArcLength(int segment);
+public:
+    CameraSpline();
+
+    void build(const std::vector<vec3f>& points, const std::vector<quatf>& rotations);
+
+    // add or remove a point at the end, updating only the segments it changes
+    void append(const vec3f& point, const quatf& rotation);
+    void removeLast();
+
+    int getSegmentCount() const;
+
+    // length of the segment from point segment to point segment+1
+    float getLength(int segment) const;
+
+    // position and orientation a fraction s of the way along the segment
+    void evaluate(int segment, float s, vec3f& pos, quatf& rotation) const;
+};
+
+#endif
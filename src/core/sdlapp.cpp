@@ -295,7 +295,23 @@ int SDLApp::run() {
     msec = SDL_GetTicks();
     last_msec = msec;
 
+    bool woken = false;
+
     while(!appFinished) {
+
+        //sleep until there is an event rather than drawing the same frame again
+        //(but not again before the event that woke us has been processed)
+        if(!woken && isIdle()) {
+            Uint32 idle_start = SDL_GetTicks();
+
+            SDL_WaitEvent(0);
+
+            //the time spent waiting is not part of the next frame
+            msec += SDL_GetTicks() - idle_start;
+
+            woken = true;
+        }
+
         last_msec = msec;
         msec      = SDL_GetTicks();
 
@@ -311,6 +327,8 @@ int SDLApp::run() {
         delta_msec = buffer_msec;
         buffer_msec =0;
 
+        woken = false;
+
         //determine time elapsed since last time we were here
         total_msec += delta_msec;
 
@@ -91,6 +91,9 @@ public:
     virtual void logic(float t, float dt) {};
     virtual void draw(float t, float dt) {};
 
+    //true if nothing would change until the next event
+    virtual bool isIdle() { return false; };
+
     virtual void mouseMove(SDL_MouseMotionEvent *e) {};
     virtual void mouseClick(SDL_MouseButtonEvent *e) {};
     virtual void keyPress(SDL_KeyboardEvent *e) {};
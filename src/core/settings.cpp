@@ -18,6 +18,7 @@
 #include "settings.h"
 
 Regex SDLAppSettings_rect_regex("^([0-9.]+)x([0-9.]+)$");
+Regex SDLAppSettings_image_pattern_regex("^[^%]*%0?[0-9]*d[^%]*\\.(png|qoi)$");
 
 SDLAppSettings::SDLAppSettings() {
     setDisplayDefaults();
@@ -30,7 +31,12 @@ SDLAppSettings::SDLAppSettings() {
     conf_sections["fullscreen"]         = "display";
     conf_sections["multi-sampling"]     = "display";
     conf_sections["output-ppm-stream"]  = "display";
+    conf_sections["output-y4m-stream"]  = "display";
+    conf_sections["output-images"]      = "display";
+    conf_sections["output-compression"] = "display";
     conf_sections["output-framerate"]   = "display";
+    conf_sections["output-queue-depth"] = "display";
+    conf_sections["output-threads"]     = "display";
     conf_sections["transparent"]        = "display";
 
     //translate args
@@ -46,7 +52,12 @@ SDLAppSettings::SDLAppSettings() {
     arg_types["transparent"]       = "bool";
     arg_types["multi-sampling"]    = "bool";
     arg_types["output-ppm-stream"] = "string";
+    arg_types["output-y4m-stream"] = "string";
+    arg_types["output-images"]     = "string";
+    arg_types["output-compression"] = "int";
     arg_types["output-framerate"]  = "int";
+    arg_types["output-queue-depth"] = "int";
+    arg_types["output-threads"]    = "int";
 
 }
 
@@ -58,7 +69,12 @@ void SDLAppSettings::setDisplayDefaults() {
     transparent    = false;
 
     output_ppm_filename = "";
+    output_y4m_filename = "";
+    output_image_pattern = "";
+    output_compression  = 6;
     output_framerate    = 60;
+    output_queue_depth  = 4;
+    output_threads      = 0;
 }
 
 void SDLAppSettings::exportDisplaySettings(ConfFile& conf) {
@@ -279,6 +295,55 @@ void SDLAppSettings::importDisplaySettings(ConfFile& conffile) {
 #endif
     }
 
+    if((entry = display_settings->getEntry("output-y4m-stream")) != 0) {
+
+        if(!entry->hasValue()) {
+            conffile.entryException(entry, "specify y4m output file or '-' for stdout");
+        }
+
+        if(output_ppm_filename.size()) {
+            conffile.entryException(entry, "cannot write both a ppm and a y4m stream");
+        }
+
+        output_y4m_filename = entry->getString();
+
+#ifdef _WIN32
+        if(output_y4m_filename == "-") {
+            conffile.entryException(entry, "stdout Y4M mode not supported on Windows");
+        }
+#endif
+    }
+
+    if((entry = display_settings->getEntry("output-images")) != 0) {
+
+        if(!entry->hasValue()) {
+            conffile.entryException(entry, "specify image file name pattern (eg frame-%05d.png)");
+        }
+
+        if(output_ppm_filename.size() || output_y4m_filename.size()) {
+            conffile.entryException(entry, "cannot write both a stream and an image sequence");
+        }
+
+        output_image_pattern = entry->getString();
+
+        if(!SDLAppSettings_image_pattern_regex.match(output_image_pattern)) {
+            conffile.entryException(entry, "image file name pattern must contain one %d and end in .png or .qoi");
+        }
+    }
+
+    if((entry = display_settings->getEntry("output-compression")) != 0) {
+
+        if(!entry->hasValue()) {
+             conffile.entryException(entry, "specify compression level (0-9)");
+        }
+
+        output_compression = entry->getInt();
+
+        if(output_compression < 0 || output_compression > 9) {
+            conffile.entryException(entry, "compression level must be between 0 and 9");
+        }
+    }
+
     if((entry = display_settings->getEntry("output-framerate")) != 0) {
 
         if(!entry->hasValue()) {
@@ -293,4 +358,30 @@ void SDLAppSettings::importDisplaySettings(ConfFile& conffile) {
             conffile.entryException(entry, "supported framerates are 25,30,60");
         }
     }
+
+    if((entry = display_settings->getEntry("output-queue-depth")) != 0) {
+
+        if(!entry->hasValue()) {
+             conffile.entryException(entry, "specify number of frames to queue for output");
+        }
+
+        output_queue_depth = entry->getInt();
+
+        if(output_queue_depth < 1) {
+            conffile.entryException(entry, "output queue depth must be at least 1");
+        }
+    }
+
+    if((entry = display_settings->getEntry("output-threads")) != 0) {
+
+        if(!entry->hasValue()) {
+             conffile.entryException(entry, "specify number of output threads");
+        }
+
+        output_threads = entry->getInt();
+
+        if(output_threads < 1 || output_threads > 16) {
+            conffile.entryException(entry, "output threads must be between 1 and 16");
+        }
+    }
 }
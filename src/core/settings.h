@@ -41,7 +41,12 @@ public:
     bool transparent;
 
     std::string output_ppm_filename;
+    std::string output_y4m_filename;
+    std::string output_image_pattern;
+    int output_compression;
     int output_framerate;
+    int output_queue_depth;
+    int output_threads;
 
     SDLAppSettings();
 
@@ -27,16 +27,34 @@
 
 #include "shader.h"
 
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/types.h>
+#include <sys/stat.h>
+#endif
+
 ShaderManager shadermanager;
 
 //ShaderManager
 
-Shader* ShaderManager::grab(std::string shader_prefix) {
-    Resource* s = resources[shader_prefix];
+void ShaderManager::setCacheDir(const std::string& cache_dir) {
+    this->cache_dir = cache_dir;
+}
+
+const std::string& ShaderManager::getCacheDir() {
+    return cache_dir;
+}
+
+Shader* ShaderManager::grab(std::string shader_prefix, std::string defines) {
+
+    std::string name = shader_prefix + defines;
+
+    Resource* s = resources[name];
 
     if(s==0) {
-        s = new Shader(shader_prefix);
-        resources[shader_prefix] = s;
+        s = new Shader(shader_prefix, defines);
+        resources[name] = s;
     }
 
     s->addref();
@@ -45,7 +63,9 @@ Shader* ShaderManager::grab(std::string shader_prefix) {
 }
 
 //Shader
-Shader::Shader(std::string prefix) : Resource(prefix) {
+Shader::Shader(std::string prefix, std::string defines) : Resource(prefix + defines) {
+
+    this->defines = defines;
 
     if(!gShadersEnabled) {
         printf("shaders are not enabled\n");
@@ -57,27 +77,202 @@ Shader::Shader(std::string prefix) : Resource(prefix) {
     std::string vertexSrc   = shader_dir + prefix + std::string(".vert");
     std::string fragmentSrc = shader_dir + prefix + std::string(".frag");
 
-    vertexShader   = load(vertexSrc,   GL_VERTEX_SHADER_ARB);
-    fragmentShader = load(fragmentSrc, GL_FRAGMENT_SHADER_ARB);
+    Uint32 start_ticks = SDL_GetTicks();
+
+    std::string vertexSource   = load(vertexSrc);
+    std::string fragmentSource = load(fragmentSrc);
+
+    vertexShader   = 0;
+    fragmentShader = 0;
+    cached         = false;
+
+    //try the program binary cache before compiling
+    std::string cache_dir = shadermanager.getCacheDir();
+    std::string cache_file;
+    std::string cache_key;
+
+    bool use_cache = !cache_dir.empty() && GLEW_ARB_get_program_binary;
 
-    makeProgram();
+    if(use_cache) {
+        cache_key = cacheKey(vertexSource, fragmentSource);
+
+        //name the file after a hash of the key, the key itself is checked on load
+        char hash[16];
+        snprintf(hash, 16, "%08x", hashString(cache_key));
+
+        cache_file = cache_dir + prefix + std::string("-") + std::string(hash) + std::string(".bin");
+
+        cached = loadBinary(cache_file, cache_key);
+    }
+
+    if(!cached) {
+        vertexShader   = compile(vertexSrc,   vertexSource,   GL_VERTEX_SHADER_ARB);
+        fragmentShader = compile(fragmentSrc, fragmentSource, GL_FRAGMENT_SHADER_ARB);
+
+        makeProgram(use_cache);
+
+        if(use_cache) saveBinary(cache_file, cache_key);
+    }
+
+    load_time = SDL_GetTicks() - start_ticks;
+
+    debugLog("shader %s%s %s in %.0f ms\n", prefix.c_str(), defines.empty() ? "" : " (variant)", cached ? "loaded from cache" : "compiled", load_time);
 }
 
 Shader::~Shader() {
-    glDeleteObjectARB(vertexShader);
-    glDeleteObjectARB(fragmentShader);
+    if(vertexShader)   glDeleteObjectARB(vertexShader);
+    if(fragmentShader) glDeleteObjectARB(fragmentShader);
     glDeleteObjectARB(shaderProg);
 }
 
-void Shader::makeProgram() {
+void Shader::makeProgram(bool retrievable) {
 
     shaderProg = glCreateProgramObjectARB();
     glAttachObjectARB(shaderProg,fragmentShader);
     glAttachObjectARB(shaderProg,vertexShader);
 
+    //ask the driver to keep the binary around so it can be cached
+    if(retrievable) {
+        glProgramParameteri((GLuint) shaderProg, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+
     glLinkProgramARB(shaderProg);
 }
 
+// FNV-1a
+unsigned int Shader::hashString(const std::string& str) {
+    unsigned int hash = 2166136261u;
+
+    for(size_t i = 0; i < str.size(); i++) {
+        hash ^= (unsigned char) str[i];
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+// binaries are only valid for the driver that produced them and the
+// exact source (including defines) they were compiled from
+std::string Shader::cacheKey(const std::string& vertexSource, const std::string& fragmentSource) {
+
+    char source_hash[64];
+    snprintf(source_hash, 64, "%08x %08x %u %u",
+        hashString(vertexSource), hashString(fragmentSource),
+        (unsigned int) vertexSource.size(), (unsigned int) fragmentSource.size());
+
+    std::string key;
+
+    key += std::string((const char*) glGetString(GL_VENDOR))   + std::string("\n");
+    key += std::string((const char*) glGetString(GL_RENDERER)) + std::string("\n");
+    key += std::string((const char*) glGetString(GL_VERSION))  + std::string("\n");
+    key += std::string(source_hash);
+
+    return key;
+}
+
+// cache file layout: "MBPB", key length, key, binary format, binary length, binary
+
+bool Shader::loadBinary(const std::string& filename, const std::string& key) {
+
+    std::ifstream in(filename.c_str(), std::ios::in | std::ios::binary);
+
+    if(!in.is_open()) return false;
+
+    char magic[4];
+    unsigned int key_length = 0;
+
+    in.read(magic, 4);
+    in.read((char*) &key_length, sizeof(key_length));
+
+    if(in.fail() || memcmp(magic, "MBPB", 4) != 0 || key_length != key.size()) return false;
+
+    std::string file_key(key_length, '\0');
+    in.read(&file_key[0], key_length);
+
+    //different driver or source
+    if(in.fail() || file_key != key) return false;
+
+    unsigned int binary_format = 0;
+    unsigned int binary_length = 0;
+
+    in.read((char*) &binary_format, sizeof(binary_format));
+    in.read((char*) &binary_length, sizeof(binary_length));
+
+    if(in.fail() || binary_length == 0) return false;
+
+    std::vector<char> binary(binary_length);
+    in.read(&binary[0], binary_length);
+
+    if(in.fail()) return false;
+
+    in.close();
+
+    shaderProg = glCreateProgramObjectARB();
+
+    glProgramBinary((GLuint) shaderProg, (GLenum) binary_format, &binary[0], binary_length);
+
+    //the driver may still reject it (eg after an update)
+    GLint link_status = 0;
+    glGetObjectParameterivARB(shaderProg, GL_OBJECT_LINK_STATUS_ARB, &link_status);
+
+    if(!link_status) {
+        debugLog("cached shader binary %s was rejected\n", filename.c_str());
+        glDeleteObjectARB(shaderProg);
+        shaderProg = 0;
+        return false;
+    }
+
+    return true;
+}
+
+void Shader::saveBinary(const std::string& filename, const std::string& key) {
+
+    GLint link_status = 0;
+    glGetObjectParameterivARB(shaderProg, GL_OBJECT_LINK_STATUS_ARB, &link_status);
+
+    if(!link_status) return;
+
+    GLint binary_length = 0;
+    glGetProgramiv((GLuint) shaderProg, GL_PROGRAM_BINARY_LENGTH, &binary_length);
+
+    if(binary_length <= 0) return;
+
+    std::vector<char> binary(binary_length);
+
+    GLenum binary_format = 0;
+    glGetProgramBinary((GLuint) shaderProg, binary_length, 0, &binary_format, &binary[0]);
+
+    std::string cache_dir = shadermanager.getCacheDir();
+
+    if(!cache_dir.empty()) {
+#ifdef _WIN32
+        _mkdir(cache_dir.c_str());
+#else
+        mkdir(cache_dir.c_str(), 0755);
+#endif
+    }
+
+    std::ofstream out(filename.c_str(), std::ios::out | std::ios::binary);
+
+    if(!out.is_open()) {
+        debugLog("could not write shader cache %s\n", filename.c_str());
+        return;
+    }
+
+    unsigned int key_length = key.size();
+    unsigned int format     = binary_format;
+    unsigned int length     = binary_length;
+
+    out.write("MBPB", 4);
+    out.write((const char*) &key_length, sizeof(key_length));
+    out.write(key.data(), key_length);
+    out.write((const char*) &format, sizeof(format));
+    out.write((const char*) &length, sizeof(length));
+    out.write(&binary[0], binary_length);
+
+    out.close();
+}
+
 void Shader::checkError(std::string filename, GLenum shaderRef) {
     char errormsg[1024];
     int errorlen = 0;
@@ -91,7 +286,7 @@ void Shader::checkError(std::string filename, GLenum shaderRef) {
     }
 }
 
-GLenum Shader::load(std::string filename, GLenum shaderType) {
+std::string Shader::load(std::string filename) {
 
     std::string source = readSource(filename);
 
@@ -100,6 +295,11 @@ GLenum Shader::load(std::string filename, GLenum shaderType) {
         exit(1);
     }
 
+    return addDefines(source);
+}
+
+GLenum Shader::compile(std::string filename, const std::string& source, GLenum shaderType) {
+
     GLenum shaderRef = glCreateShaderObjectARB(shaderType);
 
     const char* source_ptr = source.c_str();
@@ -134,6 +334,22 @@ std::string Shader::readSource(std::string file) {
     return source;
 }
 
+std::string Shader::addDefines(const std::string& source) {
+
+    if(defines.empty()) return source;
+
+    //#version must stay the first statement
+    if(source.compare(0, 8, "#version") == 0) {
+        size_t eol = source.find('\n');
+
+        if(eol != std::string::npos) {
+            return source.substr(0, eol+1) + defines + source.substr(eol+1);
+        }
+    }
+
+    return defines + source;
+}
+
 void Shader::use() {
     glUseProgramObjectARB(shaderProg);
 }
@@ -150,7 +366,23 @@ GLenum Shader::getFragmentShader() {
     return fragmentShader;
 }
 
-GLint Shader::getVarLocation(std::string& name) {
+const std::string& Shader::getDefines() {
+    return defines;
+}
+
+bool Shader::isCached() {
+    return cached;
+}
+
+float Shader::getLoadTime() {
+    return load_time;
+}
+
+GLint Shader::getUniformLocation(const char* name) {
+    return glGetUniformLocationARB(shaderProg, name);
+}
+
+GLint Shader::getVarLocation(const std::string& name) {
 
     GLint loc = varMap[name] - 1;
 
@@ -163,32 +395,32 @@ GLint Shader::getVarLocation(std::string& name) {
     return loc;
 }
 
-void Shader::setFloat(std::string varname, float value) {
+void Shader::setFloat(const std::string& varname, float value) {
     GLint loc = getVarLocation(varname);
     glUniform1fARB(loc, value);
 }
 
-void Shader::setVec2 (std::string varname, vec2f value) {
+void Shader::setVec2 (const std::string& varname, vec2f value) {
     GLint loc = getVarLocation(varname);
     glUniform2fvARB(loc, 1, value);
 }
 
-void Shader::setVec3 (std::string varname, vec3f value) {
+void Shader::setVec3 (const std::string& varname, vec3f value) {
     GLint loc = getVarLocation(varname);
     glUniform3fvARB(loc, 1, value);
 }
 
-void Shader::setVec4 (std::string varname, vec4f value) {
+void Shader::setVec4 (const std::string& varname, vec4f value) {
     GLint loc =  getVarLocation(varname);
     glUniform4fvARB(loc, 1, value);
 }
 
-void Shader::setMat3 (std::string varname, mat3f value) {
+void Shader::setMat3 (const std::string& varname, mat3f value) {
     GLint loc =  getVarLocation(varname);
     glUniformMatrix3fvARB(loc, 1, 0, value);
 }
 
-void Shader::setInteger (std::string varname, int value) {
+void Shader::setInteger (const std::string& varname, int value) {
     GLint loc =  getVarLocation(varname);
     glUniform1iARB(loc, value);
 }
@@ -35,6 +35,7 @@
 
 #include <map>
 #include <string>
+#include <vector>
 #include <fstream>
 
 class Shader : public Resource {
@@ -45,34 +46,66 @@ class Shader : public Resource {
     GLenum vertexShader;
     GLenum fragmentShader;
 
-    GLint getVarLocation(std::string& name);
+    std::string defines;
+
+    bool  cached;
+    float load_time;
+
+    GLint getVarLocation(const std::string& name);
 
     std::string readSource(std::string filename);
-    GLenum load(std::string filename, GLenum shaderType);
-    void makeProgram();
+    std::string addDefines(const std::string& source);
+    std::string load(std::string filename);
+    GLenum compile(std::string filename, const std::string& source, GLenum shaderType);
+    void makeProgram(bool retrievable);
+
+    static unsigned int hashString(const std::string& str);
+
+    std::string cacheKey(const std::string& vertexSource, const std::string& fragmentSource);
+    bool loadBinary(const std::string& filename, const std::string& key);
+    void saveBinary(const std::string& filename, const std::string& key);
 
     void checkError(std::string filename, GLenum shaderRef);
 public:
-    Shader(std::string prefix);
+    Shader(std::string prefix, std::string defines = "");
     ~Shader();
 
     GLenum getProgram();
     GLenum getVertexShader();
     GLenum getFragmentShader();
 
-    void setInteger (std::string varname, int value);
-    void setFloat(std::string varname, float value);
-    void setVec2 (std::string varname, vec2f value);
-    void setVec3 (std::string varname, vec3f value);
-    void setVec4 (std::string varname, vec4f value);
+    const std::string& getDefines();
+
+    // true if the program was loaded from the binary cache
+    bool isCached();
+
+    // milliseconds taken to compile and link (or load) the program
+    float getLoadTime();
+
+    // location of a uniform straight from the driver, -1 if unused
+    GLint getUniformLocation(const char* name);
+
+    void setInteger (const std::string& varname, int value);
+    void setFloat(const std::string& varname, float value);
+    void setVec2 (const std::string& varname, vec2f value);
+    void setVec3 (const std::string& varname, vec3f value);
+    void setVec4 (const std::string& varname, vec4f value);
 
-    void setMat3 (std::string varname, mat3f value);
+    void setMat3 (const std::string& varname, mat3f value);
     void use();
 };
 
 class ShaderManager : public ResourceManager {
+    std::string cache_dir;
 public:
-    Shader* grab(std::string shader_prefix);
+    // directory to cache linked program binaries in (requires
+    // GL_ARB_get_program_binary), caching is disabled if empty
+    void setCacheDir(const std::string& cache_dir);
+    const std::string& getCacheDir();
+
+    // defines are inserted at the top of the source (eg "#define FOO\n"),
+    // each distinct set is compiled the first time it is grabbed
+    Shader* grab(std::string shader_prefix, std::string defines = "");
 };
 
 extern ShaderManager shadermanager;
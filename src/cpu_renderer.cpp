@@ -0,0 +1,603 @@
+/*
+    Copyright (C) 2010 Andrew Caudwell (acaudwell@gmail.com)
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version
+    3 of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "cpu_renderer.h"
+
+#include <algorithm>
+
+#define MIN_EPSILON 3e-7f
+
+// GLSL 'v * m' with the matrix uploaded by Shader::setMat3
+static inline vec3f rotate(const mat3f& m, const vec3f& v) {
+    return vec3f( m.matrix[0][0] * v.x + m.matrix[0][1] * v.y + m.matrix[0][2] * v.z,
+                  m.matrix[1][0] * v.x + m.matrix[1][1] * v.y + m.matrix[1][2] * v.z,
+                  m.matrix[2][0] * v.x + m.matrix[2][1] * v.y + m.matrix[2][2] * v.z );
+}
+
+static inline float clampf(float x, float min_value, float max_value) {
+    return std::min(std::max(x, min_value), max_value);
+}
+
+CPURenderer::CPURenderer() {
+    setKernel(CPU_KERNEL_AUTO);
+}
+
+void CPURenderer::setKernel(CPUKernelType kernel) {
+
+    if(kernel == CPU_KERNEL_AUTO) kernel = cpuBestKernel();
+    if(!cpuKernelSupported(kernel)) kernel = CPU_KERNEL_SCALAR;
+
+    this->kernel = kernel;
+    march    = cpuMarchFunction(kernel);
+    distance = cpuDistanceFunction(kernel);
+}
+
+CPUKernelType CPURenderer::getKernel() const {
+    return kernel;
+}
+
+void CPURenderer::setUniforms(const MandelbulbUniforms& uniforms) {
+    u = uniforms;
+
+    //values the shader derives from its uniforms at global scope
+    texelSize   = vec2f(1.0f / u.width, 1.0f / u.height);
+    aspectRatio = u.width / u.height;
+
+    eye = rotate(u.objRotation, u.camera + u.cameraFine);
+
+    light_position = rotate(u.objRotation, u.light);
+
+    ray_rotation = u.objRotation * u.viewRotation;
+
+    sampleStep         = 1.0f / float(u.antialiasing + 1);
+    sampleContribution = 1.0f / powf(float(u.antialiasing + 1), 2.0f);
+    pixel_scale        = 1.0f / std::max(u.width, u.height);
+
+    fov_multi = tanf(u.fov * 0.017453292f * 0.5f);
+    zoom      = expf(u.cameraZoom);
+
+    //the same sample positions as the loop in shade()
+    sample_offsets.clear();
+
+    if(u.antialiasing <= 0) {
+        sample_offsets.push_back(vec2f(0.0f, 0.0f));
+    } else {
+        for (float i = 0.0f; i < 1.0f; i += sampleStep)
+            for (float j = 0.0f; j < 1.0f; j += sampleStep)
+                sample_offsets.push_back(vec2f(i * texelSize.x, j * texelSize.y));
+    }
+
+    params.eye_x = eye.x;
+    params.eye_y = eye.y;
+    params.eye_z = eye.z;
+
+    params.bounding = u.bounding;
+    params.bailout  = u.bailout;
+    params.power    = u.power;
+
+    params.int_power = u.intPower;
+
+    params.julia   = u.julia;
+    params.julia_x = u.julia_c.x;
+    params.julia_y = u.julia_c.y;
+    params.julia_z = u.julia_c.z;
+
+    params.pulse       = u.pulse > 0.0f;
+    params.pulse_scale = sinf(u.pulse*0.5f+0.5f)*u.pulseScale;
+
+    params.radiolaria       = u.radiolaria;
+    params.radiolariaFactor = u.radiolariaFactor;
+
+    params.maxIterations = u.maxIterations;
+    params.max_steps     = int(float(u.stepLimit) / u.epsilonScale);
+    params.epsilonScale  = u.epsilonScale;
+    params.pixel_scale   = pixel_scale;
+}
+
+void CPURenderer::powN(vec3f& z, float zr0, float& dr) const {
+    float zo0 = asinf(z.z / zr0);
+    float zi0 = atan2f(z.y, z.x);
+    float zr  = powf(zr0, u.power - 1.0f);
+    float zo  = zo0 * u.power;
+    float zi  = zi0 * u.power;
+    float czo = cosf(zo);
+
+    dr = zr * dr * u.power + 1.0f;
+    zr *= zr0;
+
+    z = zr * vec3f(czo*cosf(zi), czo*sinf(zi), -sinf(zo));
+}
+
+static inline vec2f complexMul(const vec2f& a, const vec2f& b) {
+    return vec2f(a.x*b.x - a.y*b.y, a.x*b.y + a.y*b.x);
+}
+
+void CPURenderer::powNInteger(vec3f& z, float zr0, float& dr) const {
+    float rho = sqrtf(z.x*z.x + z.y*z.y);
+
+    vec2f phi   = rho > 0.0f ? vec2f(z.x, z.y) / rho : vec2f(1.0f, 0.0f);
+    vec2f theta = zr0 > 0.0f ? vec2f(rho, z.z) / zr0 : vec2f(1.0f, 0.0f);
+
+    vec2f phiN(1.0f, 0.0f);
+    vec2f thetaN(1.0f, 0.0f);
+    float zr = 1.0f;
+
+    vec2f phiP   = phi;
+    vec2f thetaP = theta;
+    float zrP    = zr0;
+
+    for (int e = u.intPower - 1; e > 0; e /= 2) {
+        if (e - 2 * (e / 2) == 1) {
+            phiN   = complexMul(phiN, phiP);
+            thetaN = complexMul(thetaN, thetaP);
+            zr    *= zrP;
+        }
+        phiP   = complexMul(phiP, phiP);
+        thetaP = complexMul(thetaP, thetaP);
+        zrP   *= zrP;
+    }
+
+    phiN   = complexMul(phiN, phi);
+    thetaN = complexMul(thetaN, theta);
+
+    dr = zr * dr * u.power + 1.0f;
+    zr *= zr0;
+
+    z = zr * vec3f(thetaN.x*phiN.x, thetaN.x*phiN.y, -thetaN.y);
+}
+
+float CPURenderer::DE(const vec3f& z0, float& min_dist) const {
+
+    vec3f c = u.julia ? u.julia_c : z0;
+    vec3f z = z0;
+
+    float dr = 1.0f;
+    float r  = z.length();
+    if (r < min_dist) min_dist = r;
+
+    for (int n = 0; n < u.maxIterations; n++) {
+        if (u.intPower > 0) powNInteger(z, r, dr);
+        else powN(z, r, dr);
+
+        z += c;
+        if(u.pulse>0.0f) z *= sinf(u.pulse*0.5f+0.5f)*u.pulseScale;
+
+        if (u.radiolaria && z.y > u.radiolariaFactor) z.y = u.radiolariaFactor;
+
+        r = z.length();
+        if (r < min_dist) min_dist = r;
+        if (r > u.bailout) break;
+    }
+
+    return 0.5f * logf(r) * r / dr;
+}
+
+bool CPURenderer::intersectBoundingSphere(const vec3f& origin, const vec3f& direction, float& tmin, float& tmax) const {
+    bool hit = false;
+
+    float b = origin.dot(direction);
+    float c = origin.dot(origin) - u.bounding;
+    float disc = b*b - c;
+    tmin = tmax = 0.0f;
+
+    if (disc > 0.0f) {
+        float sdisc = sqrtf(disc);
+        float t0 = -b - sdisc;
+        float t1 = -b + sdisc;
+
+        //the shader leaves min_dist undefined here, it is not used
+        float min_dist = 4.0f;
+
+        if (t0 >= 0.0f) {
+            //ray intersects front of sphere
+            tmin = DE(origin + t0 * direction, min_dist);
+            tmax = t0 + t1;
+        } else {
+            //ray starts inside sphere
+            tmin = DE(origin, min_dist);
+            tmax = t1;
+        }
+        hit = true;
+    }
+
+    return hit;
+}
+
+vec3f CPURenderer::estimate_normal(const vec3f& z, float e) const {
+    float min_dst = 4.0f;
+
+    float dx = DE(z + vec3f(e, 0, 0), min_dst) - DE(z - vec3f(e, 0, 0), min_dst);
+    float dy = DE(z + vec3f(0, e, 0), min_dst) - DE(z - vec3f(0, e, 0), min_dst);
+    float dz = DE(z + vec3f(0, 0, e), min_dst) - DE(z - vec3f(0, 0, e), min_dst);
+
+    return (vec3f(dx, dy, dz) / (2.0f*e)).normal();
+}
+
+vec3f CPURenderer::Phong(const vec3f& pt, const vec3f& N, float& specular) const {
+    vec3f diffuse;
+    specular = 0.0f;
+
+    vec3f L = (light_position - pt).normal();
+    float NdotL = N.dot(L);
+
+    if (NdotL > 0.0f) {
+        //diffuse shading
+        diffuse = u.diffuseColor.truncate() + vec3f(fabsf(N.x), fabsf(N.y), fabsf(N.z)) * u.colorSpread;
+        diffuse = vec3f(diffuse.x * u.lightColor.x, diffuse.y * u.lightColor.y, diffuse.z * u.lightColor.z) * NdotL;
+
+        //phong highlight
+        vec3f E = (eye - pt).normal();
+        vec3f R = L - 2.0f * NdotL * N;
+        float RdE = R.dot(E);
+
+        if (RdE <= 0.0f) {
+            specular = u.specularity * powf(fabsf(RdE), u.specularExponent);
+        }
+    } else {
+        diffuse = u.diffuseColor.truncate() * fabsf(NdotL) * u.rimLight;
+    }
+
+    return u.ambientColor.truncate() * u.ambientColor.w + diffuse;
+}
+
+vec3f CPURenderer::rayDirection(const vec2f& p) const {
+    vec3f direction(p.x * fov_multi * aspectRatio, p.y * fov_multi, zoom);
+
+    return rotate(ray_rotation, direction).normal();
+}
+
+vec4f CPURenderer::renderPixel(const vec2f& pixel) const {
+    float tmin, tmax;
+    vec3f ray_direction = rayDirection(pixel);
+
+    if(!intersectBoundingSphere(eye, ray_direction, tmin, tmax)) {
+        return u.backgroundColor;
+    }
+
+    CPURayState state;
+
+    state.ray        = eye + tmin * ray_direction;
+    state.dist       = 4.0f;
+    state.min_dist   = 4.0f;
+    state.ray_length = tmin;
+    state.eps        = MIN_EPSILON;
+
+    int i;
+    float f;
+
+    for (i = 0; i < params.max_steps; ++i) {
+        state.dist = DE(state.ray, state.min_dist);
+
+        //march ray forward
+        f = u.epsilonScale * state.dist;
+        state.ray += f * ray_direction;
+        state.ray_length += f;
+
+        //within the intersection threshold or completely missed the fractal
+        if (state.dist < state.eps || state.ray_length > tmax) {
+            break;
+        }
+
+        //set the intersection threshold as a function of the ray length away from the camera
+        state.eps = std::max(MIN_EPSILON, pixel_scale * state.ray_length);
+    }
+
+    state.steps      = i;
+    state.has_normal = false;
+
+    return shadeRay(state);
+}
+
+// the rest of renderPixel once the ray has been marched
+vec4f CPURenderer::shadeRay(CPURayState& state) const {
+
+    vec3f& ray = state.ray;
+
+    float dist       = state.dist;
+    float min_dist   = state.min_dist;
+    float ray_length = state.ray_length;
+    float eps        = state.eps;
+    int   i          = state.steps;
+    int   max_steps  = params.max_steps;
+
+    float f;
+    float aoScale = u.aoSteps / u.epsilonScale;
+
+    vec4f pixel_color = u.backgroundColor;
+
+    vec3f rgb = pixel_color.truncate();
+    float alpha = pixel_color.w;
+
+    float ao = 1.0f - clampf(1.0f - min_dist * min_dist, 0.0f, 1.0f) * u.ambientOcclusion;
+
+    if (dist < eps) {
+
+        if (u.phong) {
+            vec3f normal = state.has_normal ? state.normal : estimate_normal(ray, eps/2.0f);
+            float specular = 0.0f;
+            rgb = Phong(ray, normal, specular);
+
+            if (u.shadows > 0.0f) {
+                //march towards the light, starting slightly off the surface
+                vec3f light_direction = rotate(u.objRotation, u.light - ray).normal();
+                ray += normal * eps * 2.0f;
+
+                float min_dist2 = 4.0f;
+                dist = 4.0f;
+
+                for (int j = 0; j < max_steps; ++j) {
+                    dist = DE(ray, min_dist2);
+
+                    f = u.epsilonScale * dist;
+                    ray += f * light_direction;
+
+                    if (dist < eps || ray.dot(ray) > u.bounding * u.bounding) break;
+                }
+
+                if (dist < eps) {
+                    rgb *= 1.0f - u.shadows;
+                } else {
+                    //only add specular component when there is no shadow
+                    rgb += vec3f(specular, specular, specular);
+                }
+            } else {
+                rgb += vec3f(specular, specular, specular);
+            }
+        } else {
+            //just use the base colour
+            rgb = u.diffuseColor.truncate();
+        }
+
+        ao *= 1.0f - std::min(1.0f, float(i) / aoScale) * u.ambientOcclusionEmphasis * 2.0f;
+
+        rgb *= ao;
+        alpha = 1.0f;
+
+    } else if(u.backgroundGradient) {
+        rgb   = u.backgroundColor.truncate() * (1.0f - std::min(1.0f, float(i) / aoScale));
+        alpha = u.backgroundColor.w;
+    }
+
+    if(u.fogDistance>0.0f) {
+        float fog_alpha = std::min(ray_length*ray_length, u.fogDistance)/u.fogDistance;
+        rgb = u.backgroundColor.truncate() * fog_alpha + rgb * (1.0f - fog_alpha);
+    }
+
+    if(u.glowDepth>0.0f) {
+        float glow_alpha = std::min(min_dist, u.glowDepth)/u.glowDepth;
+        if(u.rave) glow_alpha += ao;
+
+        glow_alpha *= glow_alpha;
+
+        rgb = rgb * glow_alpha + u.glowColour * u.glowMulti * (1.0f-glow_alpha);
+    }
+
+    return vec4f(rgb, alpha);
+}
+
+vec4f CPURenderer::shade(const vec2f& p) const {
+
+    if (u.antialiasing <= 0) return renderPixel(p);
+
+    vec4f c(0.0f, 0.0f, 0.0f, 1.0f);
+
+    //average (antialiasing+1)^2 points per pixel
+    for (size_t s = 0; s < sample_offsets.size(); s++)
+        c += renderPixel(p + sample_offsets[s]) * sampleContribution;
+
+    return c;
+}
+
+static inline void writePixel(unsigned char* rgb, const vec4f& c) {
+    rgb[0] = (unsigned char) (clampf(c.x, 0.0f, 1.0f) * 255.0f + 0.5f);
+    rgb[1] = (unsigned char) (clampf(c.y, 0.0f, 1.0f) * 255.0f + 0.5f);
+    rgb[2] = (unsigned char) (clampf(c.z, 0.0f, 1.0f) * 255.0f + 0.5f);
+}
+
+// estimate_normal for each ray of the batch that hit the surface,
+// evaluating the six distance estimates per ray in batches
+void CPURenderer::estimateNormals(const CPURayBatch& batch, CPURayState* states) const {
+
+    static const vec3f offsets[6] = {
+        vec3f( 1.0f, 0.0f, 0.0f), vec3f(-1.0f, 0.0f, 0.0f),
+        vec3f( 0.0f, 1.0f, 0.0f), vec3f( 0.0f,-1.0f, 0.0f),
+        vec3f( 0.0f, 0.0f, 1.0f), vec3f( 0.0f, 0.0f,-1.0f)
+    };
+
+    float de[CPU_RAY_BATCH_SIZE * 6];
+
+    int rays[CPU_RAY_BATCH_SIZE];
+    int nrays = 0;
+
+    for(int r = 0; r < batch.count; r++) {
+        if(batch.hit[r] != 0.0f && states[r].dist < states[r].eps) rays[nrays++] = r;
+    }
+
+    CPUPointBatch points;
+
+    for(int first = 0; first < nrays * 6; first += CPU_RAY_BATCH_SIZE) {
+
+        points.count = std::min(CPU_RAY_BATCH_SIZE, nrays * 6 - first);
+
+        for(int p = 0; p < points.count; p++) {
+            const CPURayState& state = states[rays[(first + p) / 6]];
+
+            vec3f z = state.ray + offsets[(first + p) % 6] * (state.eps/2.0f);
+
+            points.x[p] = z.x;
+            points.y[p] = z.y;
+            points.z[p] = z.z;
+        }
+
+        distance(params, points);
+
+        for(int p = 0; p < points.count; p++) {
+            de[first + p] = points.dist[p];
+        }
+    }
+
+    for(int n = 0; n < nrays; n++) {
+        CPURayState& state = states[rays[n]];
+
+        const float* d = de + n * 6;
+
+        float e = state.eps/2.0f;
+
+        state.normal     = (vec3f(d[0] - d[1], d[2] - d[3], d[4] - d[5]) / (2.0f*e)).normal();
+        state.has_normal = true;
+    }
+}
+
+// march every sample of the pixels CPU_RAY_BATCH_SIZE rays at a time
+void CPURenderer::renderBatched(unsigned char* rgb, size_t rowstride, const vec2i* pixels, int count) const {
+
+    int width  = (int) u.width;
+    int height = (int) u.height;
+
+    int samples = sample_offsets.size();
+    int total   = count * samples;
+
+    std::vector<vec4f> colour(count, u.antialiasing <= 0 ? vec4f(0.0f, 0.0f, 0.0f, 0.0f) : vec4f(0.0f, 0.0f, 0.0f, 1.0f));
+
+    float contribution = u.antialiasing <= 0 ? 1.0f : sampleContribution;
+
+    CPURayBatch batch;
+
+    for(int first = 0; first < total; first += CPU_RAY_BATCH_SIZE) {
+
+        batch.count = std::min(CPU_RAY_BATCH_SIZE, total - first);
+
+        for(int r = 0; r < batch.count; r++) {
+            const vec2i& pixel = pixels[(first + r) / samples];
+            int s = (first + r) % samples;
+
+            float px = 2.0f * (pixel.x + 0.5f) / width - 1.0f;
+            float py = 1.0f - 2.0f * (pixel.y + 0.5f) / height;
+
+            vec3f ray_direction = rayDirection(vec2f(px, py) + sample_offsets[s]);
+
+            batch.dir_x[r] = ray_direction.x;
+            batch.dir_y[r] = ray_direction.y;
+            batch.dir_z[r] = ray_direction.z;
+        }
+
+        march(params, batch);
+
+        CPURayState states[CPU_RAY_BATCH_SIZE];
+
+        for(int r = 0; r < batch.count; r++) {
+            states[r].ray        = vec3f(batch.pos_x[r], batch.pos_y[r], batch.pos_z[r]);
+            states[r].ray_length = batch.ray_length[r];
+            states[r].dist       = batch.dist[r];
+            states[r].min_dist   = batch.min_dist[r];
+            states[r].eps        = batch.eps[r];
+            states[r].steps      = (int) batch.steps[r];
+            states[r].has_normal = false;
+        }
+
+        if(u.phong) estimateNormals(batch, states);
+
+        for(int r = 0; r < batch.count; r++) {
+            int p = (first + r) / samples;
+
+            if(batch.hit[r] == 0.0f) {
+                colour[p] += u.backgroundColor * contribution;
+            } else {
+                colour[p] += shadeRay(states[r]) * contribution;
+            }
+        }
+    }
+
+    for(int p = 0; p < count; p++) {
+        writePixel(rgb + pixels[p].y * rowstride + pixels[p].x * 3, colour[p]);
+    }
+}
+
+void CPURenderer::render(unsigned char* rgb, size_t rowstride, int y_start, int y_end) const {
+
+    int width  = (int) u.width;
+    int height = (int) u.height;
+
+    std::vector<vec2i> pixels(width);
+
+    for(int y = y_start; y < y_end; y++) {
+        unsigned char* row = rgb + y * rowstride;
+
+        if(march != 0) {
+            for(int x = 0; x < width; x++) pixels[x] = vec2i(x, y);
+
+            renderBatched(rgb, rowstride, &pixels[0], width);
+            continue;
+        }
+
+        //the quad puts +1 at the top of the screen, sample at pixel centres
+        float py = 1.0f - 2.0f * (y + 0.5f) / height;
+
+        for(int x = 0; x < width; x++) {
+            float px = 2.0f * (x + 0.5f) / width - 1.0f;
+
+            writePixel(row + x*3, shade(vec2f(px, py)));
+        }
+    }
+}
+
+// every other bit of d, ie one coordinate of a Morton code
+static inline int mortonCoordinate(int d) {
+    d &= 0x55555555;
+    d = (d | (d >> 1)) & 0x33333333;
+    d = (d | (d >> 2)) & 0x0F0F0F0F;
+    d = (d | (d >> 4)) & 0x00FF00FF;
+    d = (d | (d >> 8)) & 0x0000FFFF;
+    return d;
+}
+
+void CPURenderer::renderTile(unsigned char* rgb, size_t rowstride, int x, int y, int w, int h) const {
+
+    int width  = (int) u.width;
+    int height = (int) u.height;
+
+    w = std::min(w, width  - x);
+    h = std::min(h, height - y);
+
+    if(w <= 0 || h <= 0) return;
+
+    int n = 1;
+    while(n < w || n < h) n *= 2;
+
+    std::vector<vec2i> pixels;
+    pixels.reserve(w * h);
+
+    //walk the Z curve over the enclosing power of two square
+    for(int d = 0; d < n * n; d++) {
+        int px = mortonCoordinate(d);
+        int py = mortonCoordinate(d >> 1);
+
+        if(px < w && py < h) pixels.push_back(vec2i(x + px, y + py));
+    }
+
+    if(march != 0) {
+        renderBatched(rgb, rowstride, &pixels[0], pixels.size());
+        return;
+    }
+
+    for(size_t i = 0; i < pixels.size(); i++) {
+        float px = 2.0f * (pixels[i].x + 0.5f) / width - 1.0f;
+        float py = 1.0f - 2.0f * (pixels[i].y + 0.5f) / height;
+
+        writePixel(rgb + pixels[i].y * rowstride + pixels[i].x * 3, shade(vec2f(px, py)));
+    }
+}
@@ -0,0 +1,116 @@
+/*
+    Copyright (C) 2010 Andrew Caudwell (acaudwell@gmail.com)
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version
+    3 of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef MANDELBULB_CPU_RENDERER_H
+#define MANDELBULB_CPU_RENDERER_H
+
+#include "viewer_uniforms.h"
+#include "cpu_simd.h"
+
+#include <cstddef>
+#include <vector>
+
+// A CPU port of MandelbulbQuick.frag.
+//
+// Each function mirrors the GLSL function of the same name and uses
+// single precision throughout so the output matches the shader to
+// within rounding differences of the driver's transcendental functions.
+//
+// render() marches rays in batches with one of the vectorized kernels
+// from cpu_simd.h unless the reference kernel is selected, then shades
+// the hits with the same functions as the reference path.
+//
+// The render functions only read the renderer, so threads can render
+// different parts of an image at the same time.
+
+// where renderPixel's march loop stopped
+
+class CPURayState {
+public:
+    vec3f ray;
+    float ray_length;
+    float dist;
+    float min_dist;
+    float eps;
+    int   steps;
+
+    //set when the surface normal was estimated by a batched kernel
+    bool  has_normal;
+    vec3f normal;
+};
+
+class CPURenderer {
+    MandelbulbUniforms u;
+
+    vec3f eye;
+    vec3f light_position;
+    mat3f ray_rotation;
+
+    float aspectRatio;
+    float fov_multi;
+    float zoom;
+
+    vec2f texelSize;
+    float sampleStep;
+    float sampleContribution;
+    float pixel_scale;
+
+    std::vector<vec2f> sample_offsets;
+
+    CPUKernelType   kernel;
+    CPUMarchFunc    march;
+    CPUDistanceFunc distance;
+    CPUMarchParams  params;
+
+    void  powN(vec3f& z, float zr0, float& dr) const;
+    void  powNInteger(vec3f& z, float zr0, float& dr) const;
+    float DE(const vec3f& z0, float& min_dist) const;
+
+    bool  intersectBoundingSphere(const vec3f& origin, const vec3f& direction, float& tmin, float& tmax) const;
+
+    vec3f estimate_normal(const vec3f& z, float e) const;
+    vec3f Phong(const vec3f& pt, const vec3f& N, float& specular) const;
+
+    vec3f rayDirection(const vec2f& p) const;
+    vec4f shadeRay(CPURayState& state) const;
+    vec4f renderPixel(const vec2f& pixel) const;
+
+    void estimateNormals(const CPURayBatch& batch, CPURayState* states) const;
+    void renderBatched(unsigned char* rgb, size_t rowstride, const vec2i* pixels, int count) const;
+public:
+    CPURenderer();
+
+    void setUniforms(const MandelbulbUniforms& uniforms);
+
+    // kernel used by render(), defaults to the best one available
+    void setKernel(CPUKernelType kernel);
+    CPUKernelType getKernel() const;
+
+    // colour of the fragment at p, where p is in the [-1,1] range
+    // covered by the quad drawn by MandelbulbViewer::drawAlignedQuad
+    vec4f shade(const vec2f& p) const;
+
+    // render rows [y_start, y_end) of a width x height RGB image,
+    // top row first, into rgb (rowstride bytes per row)
+    void render(unsigned char* rgb, size_t rowstride, int y_start, int y_end) const;
+
+    // render the w x h area at x,y of the same image, visiting the
+    // pixels in Morton order so each batch of rays is a compact block
+    void renderTile(unsigned char* rgb, size_t rowstride, int x, int y, int w, int h) const;
+};
+
+#endif
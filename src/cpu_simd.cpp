@@ -0,0 +1,214 @@
+/*
+    Copyright (C) 2010 Andrew Caudwell (acaudwell@gmail.com)
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version
+    3 of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "cpu_simd.h"
+
+#include <cmath>
+#include <cstring>
+
+CPURayBatch::CPURayBatch() {
+    count = 0;
+
+    memset(dir_x, 0, sizeof(dir_x));
+    memset(dir_y, 0, sizeof(dir_y));
+    memset(dir_z, 0, sizeof(dir_z));
+}
+
+CPUPointBatch::CPUPointBatch() {
+    count = 0;
+
+    memset(x, 0, sizeof(x));
+    memset(y, 0, sizeof(y));
+    memset(z, 0, sizeof(z));
+}
+
+namespace {
+
+// one lane 'vector' for processors without a usable SIMD kernel
+
+class vfloat1 {
+public:
+    float v;
+
+    typedef bool mask;
+    enum { width = 1 };
+
+    vfloat1() {}
+    vfloat1(float v) : v(v) {}
+
+    static vfloat1 lanes() { return vfloat1(0.0f); }
+};
+
+inline vfloat1 operator+(vfloat1 a, vfloat1 b) { return a.v + b.v; }
+inline vfloat1 operator-(vfloat1 a, vfloat1 b) { return a.v - b.v; }
+inline vfloat1 operator*(vfloat1 a, vfloat1 b) { return a.v * b.v; }
+inline vfloat1 operator/(vfloat1 a, vfloat1 b) { return a.v / b.v; }
+inline vfloat1 operator-(vfloat1 a) { return -a.v; }
+
+inline bool operator<(vfloat1 a, vfloat1 b)  { return a.v < b.v; }
+inline bool operator>(vfloat1 a, vfloat1 b)  { return a.v > b.v; }
+inline bool operator>=(vfloat1 a, vfloat1 b) { return a.v >= b.v; }
+
+inline bool vandnot(bool a, bool b) { return a && !b; }
+inline bool vany(bool m) { return m; }
+
+inline vfloat1 vselect(bool m, vfloat1 a, vfloat1 b) { return m ? a : b; }
+
+inline vfloat1 vmin(vfloat1 a, vfloat1 b) { return a.v < b.v ? a : b; }
+inline vfloat1 vmax(vfloat1 a, vfloat1 b) { return a.v > b.v ? a : b; }
+inline vfloat1 vabs(vfloat1 a)   { return fabsf(a.v); }
+inline vfloat1 vsqrt(vfloat1 a)  { return sqrtf(a.v); }
+inline vfloat1 vfloor(vfloat1 a) { return floorf(a.v); }
+
+inline vfloat1 vfrexp(vfloat1 x, vfloat1& e) {
+    int exponent;
+    float m = frexpf(x.v, &exponent);
+    e = (float) (exponent - 1);
+    return m * 2.0f;
+}
+
+inline vfloat1 vldexp2(vfloat1 n) { return ldexpf(1.0f, (int) n.v); }
+
+inline vfloat1 vload(const float* p)      { return *p; }
+inline void    vstore(float* p, vfloat1 a) { *p = a.v; }
+
+#include "cpu_simd_kernel.h"
+
+}
+
+void cpuMarchScalar(const CPUMarchParams& params, CPURayBatch& batch) {
+    simd_march_batch<vfloat1>(params, batch);
+}
+
+void cpuDistanceScalar(const CPUMarchParams& params, CPUPointBatch& batch) {
+    simd_distance_batch<vfloat1>(params, batch);
+}
+
+CPUKernelType cpuBestKernel() {
+    if(cpuKernelSupported(CPU_KERNEL_AVX512)) return CPU_KERNEL_AVX512;
+    if(cpuKernelSupported(CPU_KERNEL_AVX2))   return CPU_KERNEL_AVX2;
+    if(cpuKernelSupported(CPU_KERNEL_SSE42))  return CPU_KERNEL_SSE42;
+
+    return CPU_KERNEL_SCALAR;
+}
+
+bool cpuKernelSupported(CPUKernelType kernel) {
+
+    switch(kernel) {
+#ifdef CPU_SIMD_X86
+        case CPU_KERNEL_SSE42:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("sse4.2");
+        case CPU_KERNEL_AVX2:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+        case CPU_KERNEL_AVX512:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("avx512f");
+#else
+        case CPU_KERNEL_SSE42:
+        case CPU_KERNEL_AVX2:
+        case CPU_KERNEL_AVX512:
+            return false;
+#endif
+        default:
+            break;
+    }
+
+    return true;
+}
+
+static CPUKernelType cpuResolveKernel(CPUKernelType kernel) {
+
+    if(kernel == CPU_KERNEL_AUTO) kernel = cpuBestKernel();
+
+    if(!cpuKernelSupported(kernel)) kernel = CPU_KERNEL_SCALAR;
+
+    return kernel;
+}
+
+CPUMarchFunc cpuMarchFunction(CPUKernelType kernel) {
+
+    switch(cpuResolveKernel(kernel)) {
+        case CPU_KERNEL_REFERENCE:
+            return 0;
+#ifdef CPU_SIMD_X86
+        case CPU_KERNEL_SSE42:
+            return cpuMarchSSE42;
+        case CPU_KERNEL_AVX2:
+            return cpuMarchAVX2;
+        case CPU_KERNEL_AVX512:
+            return cpuMarchAVX512;
+#endif
+        default:
+            break;
+    }
+
+    return cpuMarchScalar;
+}
+
+CPUDistanceFunc cpuDistanceFunction(CPUKernelType kernel) {
+
+    switch(cpuResolveKernel(kernel)) {
+        case CPU_KERNEL_REFERENCE:
+            return 0;
+#ifdef CPU_SIMD_X86
+        case CPU_KERNEL_SSE42:
+            return cpuDistanceSSE42;
+        case CPU_KERNEL_AVX2:
+            return cpuDistanceAVX2;
+        case CPU_KERNEL_AVX512:
+            return cpuDistanceAVX512;
+#endif
+        default:
+            break;
+    }
+
+    return cpuDistanceScalar;
+}
+
+const char* cpuKernelName(CPUKernelType kernel) {
+
+    switch(kernel) {
+        case CPU_KERNEL_REFERENCE:
+            return "reference";
+        case CPU_KERNEL_SCALAR:
+            return "scalar";
+        case CPU_KERNEL_SSE42:
+            return "sse4.2";
+        case CPU_KERNEL_AVX2:
+            return "avx2";
+        case CPU_KERNEL_AVX512:
+            return "avx512";
+        default:
+            break;
+    }
+
+    return "auto";
+}
+
+bool cpuKernelFromName(const std::string& name, CPUKernelType& kernel) {
+
+    for(int i = CPU_KERNEL_REFERENCE; i <= CPU_KERNEL_AUTO; i++) {
+        if(name == cpuKernelName((CPUKernelType) i)) {
+            kernel = (CPUKernelType) i;
+            return true;
+        }
+    }
+
+    return false;
+}
@@ -0,0 +1,149 @@
+/*
+    Copyright (C) 2010 Andrew Caudwell (acaudwell@gmail.com)
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version
+    3 of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef MANDELBULB_CPU_SIMD_H
+#define MANDELBULB_CPU_SIMD_H
+
+#include <string>
+
+// Vectorized ray marching kernels for the CPU renderer.
+//
+// Each kernel intersects a batch of rays with the bounding sphere and
+// marches them to the fractal surface in lockstep, W rays at a time
+// (1, 4, 8 or 16 depending on the instruction set), masking off lanes
+// as they hit, miss or bail out of the DE iteration.
+//
+// The instruction set specific kernels are only built with GCC on x86,
+// which lets each live in its own translation unit compiled for that
+// target while the rest of the program stays generic.
+
+#if defined(__GNUC__) && !defined(__clang__) && (defined(__x86_64__) || defined(__i386__))
+#define CPU_SIMD_X86 1
+#endif
+
+#define CPU_RAY_BATCH_SIZE 16
+
+enum CPUKernelType {
+    CPU_KERNEL_REFERENCE,
+    CPU_KERNEL_SCALAR,
+    CPU_KERNEL_SSE42,
+    CPU_KERNEL_AVX2,
+    CPU_KERNEL_AVX512,
+    CPU_KERNEL_AUTO
+};
+
+class CPUMarchParams {
+public:
+    float eye_x, eye_y, eye_z;
+
+    float bounding;
+    float bailout;
+    float power;
+
+    //power when it is a whole number, otherwise 0
+    int   int_power;
+
+    bool  julia;
+    float julia_x, julia_y, julia_z;
+
+    //z is scaled by pulse_scale after each iteration when pulsing
+    bool  pulse;
+    float pulse_scale;
+
+    bool  radiolaria;
+    float radiolariaFactor;
+
+    int   maxIterations;
+    int   max_steps;
+
+    float epsilonScale;
+    float pixel_scale;
+};
+
+// structure of arrays of up to CPU_RAY_BATCH_SIZE rays
+
+class CPURayBatch {
+public:
+    int count;
+
+    //in: normalized ray directions from the eye
+    float dir_x[CPU_RAY_BATCH_SIZE];
+    float dir_y[CPU_RAY_BATCH_SIZE];
+    float dir_z[CPU_RAY_BATCH_SIZE];
+
+    //out: 1.0 if the ray entered the bounding sphere, otherwise 0.0
+    float hit[CPU_RAY_BATCH_SIZE];
+
+    //out: the state of renderPixel's march loop when it finished
+    float pos_x[CPU_RAY_BATCH_SIZE];
+    float pos_y[CPU_RAY_BATCH_SIZE];
+    float pos_z[CPU_RAY_BATCH_SIZE];
+
+    float ray_length[CPU_RAY_BATCH_SIZE];
+    float tmax[CPU_RAY_BATCH_SIZE];
+    float dist[CPU_RAY_BATCH_SIZE];
+    float min_dist[CPU_RAY_BATCH_SIZE];
+    float eps[CPU_RAY_BATCH_SIZE];
+    float steps[CPU_RAY_BATCH_SIZE];
+
+    CPURayBatch();
+};
+
+// up to CPU_RAY_BATCH_SIZE points to estimate the distance of
+
+class CPUPointBatch {
+public:
+    int count;
+
+    float x[CPU_RAY_BATCH_SIZE];
+    float y[CPU_RAY_BATCH_SIZE];
+    float z[CPU_RAY_BATCH_SIZE];
+
+    float dist[CPU_RAY_BATCH_SIZE];
+
+    CPUPointBatch();
+};
+
+typedef void (*CPUMarchFunc)(const CPUMarchParams& params, CPURayBatch& batch);
+typedef void (*CPUDistanceFunc)(const CPUMarchParams& params, CPUPointBatch& batch);
+
+void cpuMarchScalar(const CPUMarchParams& params, CPURayBatch& batch);
+void cpuDistanceScalar(const CPUMarchParams& params, CPUPointBatch& batch);
+
+#ifdef CPU_SIMD_X86
+void cpuMarchSSE42(const CPUMarchParams& params, CPURayBatch& batch);
+void cpuMarchAVX2(const CPUMarchParams& params, CPURayBatch& batch);
+void cpuMarchAVX512(const CPUMarchParams& params, CPURayBatch& batch);
+
+void cpuDistanceSSE42(const CPUMarchParams& params, CPUPointBatch& batch);
+void cpuDistanceAVX2(const CPUMarchParams& params, CPUPointBatch& batch);
+void cpuDistanceAVX512(const CPUMarchParams& params, CPUPointBatch& batch);
+#endif
+
+// best kernel the processor we are running on supports
+CPUKernelType cpuBestKernel();
+
+bool cpuKernelSupported(CPUKernelType kernel);
+
+// these return 0 for CPU_KERNEL_REFERENCE (the unbatched GLSL port)
+CPUMarchFunc    cpuMarchFunction(CPUKernelType kernel);
+CPUDistanceFunc cpuDistanceFunction(CPUKernelType kernel);
+
+const char* cpuKernelName(CPUKernelType kernel);
+bool cpuKernelFromName(const std::string& name, CPUKernelType& kernel);
+
+#endif
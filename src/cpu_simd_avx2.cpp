@@ -0,0 +1,109 @@
+/*
+    Copyright (C) 2010 Andrew Caudwell (acaudwell@gmail.com)
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version
+    3 of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "cpu_simd.h"
+
+#ifdef CPU_SIMD_X86
+
+#include <immintrin.h>
+
+#pragma GCC push_options
+#pragma GCC target("avx2,fma")
+
+namespace {
+
+class vmask8 {
+public:
+    __m256 m;
+
+    vmask8(__m256 m) : m(m) {}
+};
+
+inline vmask8 operator&(vmask8 a, vmask8 b) { return _mm256_and_ps(a.m, b.m); }
+inline vmask8 operator|(vmask8 a, vmask8 b) { return _mm256_or_ps(a.m, b.m); }
+
+inline vmask8 vandnot(vmask8 a, vmask8 b) { return _mm256_andnot_ps(b.m, a.m); }
+inline bool   vany(vmask8 a) { return _mm256_movemask_ps(a.m) != 0; }
+
+class vfloat8 {
+public:
+    __m256 v;
+
+    typedef vmask8 mask;
+    enum { width = 8 };
+
+    vfloat8() {}
+    vfloat8(float f) : v(_mm256_set1_ps(f)) {}
+    vfloat8(__m256 v) : v(v) {}
+
+    static vfloat8 lanes() { return _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f); }
+};
+
+inline vfloat8 operator+(vfloat8 a, vfloat8 b) { return _mm256_add_ps(a.v, b.v); }
+inline vfloat8 operator-(vfloat8 a, vfloat8 b) { return _mm256_sub_ps(a.v, b.v); }
+inline vfloat8 operator*(vfloat8 a, vfloat8 b) { return _mm256_mul_ps(a.v, b.v); }
+inline vfloat8 operator/(vfloat8 a, vfloat8 b) { return _mm256_div_ps(a.v, b.v); }
+inline vfloat8 operator-(vfloat8 a) { return _mm256_xor_ps(a.v, _mm256_set1_ps(-0.0f)); }
+
+inline vmask8 operator<(vfloat8 a, vfloat8 b)  { return _mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ); }
+inline vmask8 operator>(vfloat8 a, vfloat8 b)  { return _mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ); }
+inline vmask8 operator>=(vfloat8 a, vfloat8 b) { return _mm256_cmp_ps(a.v, b.v, _CMP_GE_OQ); }
+
+inline vfloat8 vselect(vmask8 m, vfloat8 a, vfloat8 b) { return _mm256_blendv_ps(b.v, a.v, m.m); }
+
+inline vfloat8 vmin(vfloat8 a, vfloat8 b) { return _mm256_min_ps(a.v, b.v); }
+inline vfloat8 vmax(vfloat8 a, vfloat8 b) { return _mm256_max_ps(a.v, b.v); }
+inline vfloat8 vabs(vfloat8 a)   { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a.v); }
+inline vfloat8 vsqrt(vfloat8 a)  { return _mm256_sqrt_ps(a.v); }
+inline vfloat8 vfloor(vfloat8 a) { return _mm256_floor_ps(a.v); }
+
+// mantissa in [1,2) and exponent of positive normal numbers
+inline vfloat8 vfrexp(vfloat8 x, vfloat8& e) {
+    __m256i bits = _mm256_castps_si256(x.v);
+
+    e = _mm256_cvtepi32_ps(_mm256_sub_epi32(_mm256_srli_epi32(bits, 23), _mm256_set1_epi32(127)));
+
+    bits = _mm256_and_si256(bits, _mm256_set1_epi32(0x007fffff));
+    bits = _mm256_or_si256(bits,  _mm256_set1_epi32(0x3f800000));
+
+    return _mm256_castsi256_ps(bits);
+}
+
+// 2^n for integer n in [-126, 127]
+inline vfloat8 vldexp2(vfloat8 n) {
+    __m256i bits = _mm256_add_epi32(_mm256_cvtps_epi32(n.v), _mm256_set1_epi32(127));
+    return _mm256_castsi256_ps(_mm256_slli_epi32(bits, 23));
+}
+
+inline vfloat8 vload(const float* p)       { return _mm256_loadu_ps(p); }
+inline void    vstore(float* p, vfloat8 a) { _mm256_storeu_ps(p, a.v); }
+
+#include "cpu_simd_kernel.h"
+
+}
+
+void cpuMarchAVX2(const CPUMarchParams& params, CPURayBatch& batch) {
+    simd_march_batch<vfloat8>(params, batch);
+}
+
+void cpuDistanceAVX2(const CPUMarchParams& params, CPUPointBatch& batch) {
+    simd_distance_batch<vfloat8>(params, batch);
+}
+
+#pragma GCC pop_options
+
+#endif
@@ -0,0 +1,111 @@
+/*
+    Copyright (C) 2010 Andrew Caudwell (acaudwell@gmail.com)
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version
+    3 of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "cpu_simd.h"
+
+#ifdef CPU_SIMD_X86
+
+#include <immintrin.h>
+
+#pragma GCC push_options
+#pragma GCC target("avx512f")
+
+namespace {
+
+typedef __mmask16 vmask16;
+
+inline vmask16 vandnot(vmask16 a, vmask16 b) { return a & ~b; }
+inline bool    vany(vmask16 a) { return a != 0; }
+
+class vfloat16 {
+public:
+    __m512 v;
+
+    typedef vmask16 mask;
+    enum { width = 16 };
+
+    vfloat16() {}
+    vfloat16(float f) : v(_mm512_set1_ps(f)) {}
+    vfloat16(__m512 v) : v(v) {}
+
+    static vfloat16 lanes() {
+        return _mm512_setr_ps(0.0f, 1.0f, 2.0f,  3.0f,  4.0f,  5.0f,  6.0f,  7.0f,
+                              8.0f, 9.0f, 10.0f, 11.0f, 12.0f, 13.0f, 14.0f, 15.0f);
+    }
+};
+
+inline __m512 vbits(__m512i i) { return _mm512_castsi512_ps(i); }
+
+inline vfloat16 operator+(vfloat16 a, vfloat16 b) { return _mm512_add_ps(a.v, b.v); }
+inline vfloat16 operator-(vfloat16 a, vfloat16 b) { return _mm512_sub_ps(a.v, b.v); }
+inline vfloat16 operator*(vfloat16 a, vfloat16 b) { return _mm512_mul_ps(a.v, b.v); }
+inline vfloat16 operator/(vfloat16 a, vfloat16 b) { return _mm512_div_ps(a.v, b.v); }
+inline vfloat16 operator-(vfloat16 a) {
+    return vbits(_mm512_xor_epi32(_mm512_castps_si512(a.v), _mm512_set1_epi32(0x80000000)));
+}
+
+inline vmask16 operator<(vfloat16 a, vfloat16 b)  { return _mm512_cmp_ps_mask(a.v, b.v, _CMP_LT_OQ); }
+inline vmask16 operator>(vfloat16 a, vfloat16 b)  { return _mm512_cmp_ps_mask(a.v, b.v, _CMP_GT_OQ); }
+inline vmask16 operator>=(vfloat16 a, vfloat16 b) { return _mm512_cmp_ps_mask(a.v, b.v, _CMP_GE_OQ); }
+
+inline vfloat16 vselect(vmask16 m, vfloat16 a, vfloat16 b) { return _mm512_mask_blend_ps(m, b.v, a.v); }
+
+inline vfloat16 vmin(vfloat16 a, vfloat16 b) { return _mm512_min_ps(a.v, b.v); }
+inline vfloat16 vmax(vfloat16 a, vfloat16 b) { return _mm512_max_ps(a.v, b.v); }
+inline vfloat16 vsqrt(vfloat16 a)  { return _mm512_sqrt_ps(a.v); }
+inline vfloat16 vfloor(vfloat16 a) { return _mm512_roundscale_ps(a.v, _MM_FROUND_TO_NEG_INF); }
+
+inline vfloat16 vabs(vfloat16 a) {
+    return vbits(_mm512_and_epi32(_mm512_castps_si512(a.v), _mm512_set1_epi32(0x7fffffff)));
+}
+
+// mantissa in [1,2) and exponent of positive normal numbers
+inline vfloat16 vfrexp(vfloat16 x, vfloat16& e) {
+    __m512i bits = _mm512_castps_si512(x.v);
+
+    e = _mm512_cvtepi32_ps(_mm512_sub_epi32(_mm512_srli_epi32(bits, 23), _mm512_set1_epi32(127)));
+
+    bits = _mm512_and_epi32(bits, _mm512_set1_epi32(0x007fffff));
+    bits = _mm512_or_epi32(bits,  _mm512_set1_epi32(0x3f800000));
+
+    return vbits(bits);
+}
+
+// 2^n for integer n in [-126, 127]
+inline vfloat16 vldexp2(vfloat16 n) {
+    __m512i bits = _mm512_add_epi32(_mm512_cvtps_epi32(n.v), _mm512_set1_epi32(127));
+    return vbits(_mm512_slli_epi32(bits, 23));
+}
+
+inline vfloat16 vload(const float* p)        { return _mm512_loadu_ps(p); }
+inline void     vstore(float* p, vfloat16 a) { _mm512_storeu_ps(p, a.v); }
+
+#include "cpu_simd_kernel.h"
+
+}
+
+void cpuMarchAVX512(const CPUMarchParams& params, CPURayBatch& batch) {
+    simd_march_batch<vfloat16>(params, batch);
+}
+
+void cpuDistanceAVX512(const CPUMarchParams& params, CPUPointBatch& batch) {
+    simd_distance_batch<vfloat16>(params, batch);
+}
+
+#pragma GCC pop_options
+
+#endif
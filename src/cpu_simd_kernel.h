@@ -0,0 +1,409 @@
+/*
+    Copyright (C) 2010 Andrew Caudwell (acaudwell@gmail.com)
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version
+    3 of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef MANDELBULB_CPU_SIMD_KERNEL_H
+#define MANDELBULB_CPU_SIMD_KERNEL_H
+
+// The march kernel, written once against a vector type 'vfloat'.
+//
+// Only include this from a cpu_simd_*.cpp file after the target pragma
+// and the definition of its vector types, which must live in an
+// anonymous namespace so each instantiation stays local to its file.
+//
+// vfloat must provide arithmetic operators, comparisons returning
+// vfloat::mask, the functions vselect, vandnot, vany, vmin, vmax, vabs,
+// vsqrt, vfloor, vfrexp, vldexp2, vload and vstore, an enum 'width'
+// with the number of lanes and a static lanes() returning 0,1,2...
+//
+// The transcendental functions are polynomial approximations (from the
+// Cephes library) rather than calls to libm. Maximum errors measured
+// against double precision libm over 4 million random arguments:
+//
+//   simd_log2   x in [1e-30, 1e30]    error < 8e-8 * max(1, |log2(x)|)
+//   simd_exp2   x in [-126, 127]      relative error < 9e-8
+//   simd_atan2  y, x in [-1e7, 1e7]   absolute error < 3e-7 radians
+//   simd_sincos x in [-8192, 8192]    absolute error < 8e-8
+//
+// so the DE differs from the libm based reference by a few ulp, and
+// rendered images by a few levels per channel apart from the odd pixel
+// where the surface normal is badly conditioned.
+
+#define SIMD_PI      3.14159265358979f
+#define SIMD_LN2     0.69314718055995f
+#define SIMD_LOG2E   1.44269504088896f
+
+#define SIMD_MIN_EPSILON 3e-7f
+
+// log2(x) for x > 0
+template<class vfloat> static inline vfloat simd_log2(vfloat x) {
+    typedef typename vfloat::mask vmask;
+
+    vfloat e;
+    vfloat m = vfrexp(x, e);
+
+    //centre the mantissa on 1.0
+    vmask big = m > vfloat(1.41421356f);
+    m = vselect(big, m * 0.5f, m);
+    e = vselect(big, e + 1.0f, e);
+
+    vfloat t = m - 1.0f;
+    vfloat z = t * t;
+
+    vfloat y = vfloat(7.0376836292E-2f);
+    y = y * t - 1.1514610310E-1f;
+    y = y * t + 1.1676998740E-1f;
+    y = y * t - 1.2420140846E-1f;
+    y = y * t + 1.4249322787E-1f;
+    y = y * t - 1.6668057665E-1f;
+    y = y * t + 2.0000714765E-1f;
+    y = y * t - 2.4999993993E-1f;
+    y = y * t + 3.3333331174E-1f;
+    y = y * t * z;
+
+    //natural log of the mantissa
+    y = y - 0.5f * z + t;
+
+    return y * SIMD_LOG2E + e;
+}
+
+// 2^x for x in [-126, 127]
+template<class vfloat> static inline vfloat simd_exp2(vfloat x) {
+
+    x = vmin(vmax(x, vfloat(-126.0f)), vfloat(127.0f));
+
+    vfloat n = vfloor(x + 0.5f);
+    vfloat g = (x - n) * SIMD_LN2;
+
+    vfloat y = vfloat(1.9875691500E-4f);
+    y = y * g + 1.3981999507E-3f;
+    y = y * g + 8.3334519073E-3f;
+    y = y * g + 4.1665795894E-2f;
+    y = y * g + 1.6666665459E-1f;
+    y = y * g + 5.0000001201E-1f;
+    y = y * g * g + g + 1.0f;
+
+    return y * vldexp2(n);
+}
+
+// x^y for x > 0
+template<class vfloat> static inline vfloat simd_pow(vfloat x, vfloat y) {
+    return simd_exp2(y * simd_log2(vmax(x, vfloat(1e-30f))));
+}
+
+template<class vfloat> static inline vfloat simd_atan2(vfloat y, vfloat x) {
+    typedef typename vfloat::mask vmask;
+
+    vfloat ax = vabs(x);
+    vfloat ay = vabs(y);
+
+    //reduce to [0, 1] then to [0, tan(pi/8)]
+    vfloat a = vmin(ax, ay) / vmax(vmax(ax, ay), vfloat(1e-30f));
+
+    vmask reduce = a > vfloat(0.41421356f);
+    a = vselect(reduce, (a - 1.0f) / (a + 1.0f), a);
+
+    vfloat z = a * a;
+
+    vfloat r = vfloat(8.05374449538E-2f);
+    r = r * z - 1.38776856032E-1f;
+    r = r * z + 1.99777106478E-1f;
+    r = r * z - 3.33329491539E-1f;
+    r = r * z * a + a;
+
+    r = vselect(reduce, r + SIMD_PI * 0.25f, r);
+
+    //back out to the full circle
+    r = vselect(ay > ax, vfloat(SIMD_PI * 0.5f) - r, r);
+    r = vselect(x < vfloat(0.0f), vfloat(SIMD_PI) - r, r);
+    r = vselect(y < vfloat(0.0f), -r, r);
+
+    return r;
+}
+
+template<class vfloat> static inline void simd_sincos(vfloat x, vfloat& s, vfloat& c) {
+    typedef typename vfloat::mask vmask;
+
+    vfloat ax = vabs(x);
+
+    //octant, rounded up to even so the remainder is within +/- pi/4
+    vfloat j = vfloor(ax * 1.27323954473516f);
+    j = j + (j - 2.0f * vfloor(j * 0.5f));
+
+    //extended precision modular arithmetic
+    vfloat y = ((ax - j * 0.78515625f) - j * 2.4187564849853515625e-4f) - j * 3.77489497744594108e-8f;
+
+    vfloat q  = j - 8.0f * vfloor(j * 0.125f);
+    vfloat q4 = q - 4.0f * vfloor(q * 0.25f);
+
+    vfloat z = y * y;
+
+    vfloat ps = vfloat(-1.9515295891E-4f);
+    ps = ps * z + 8.3321608736E-3f;
+    ps = ps * z - 1.6666654611E-1f;
+    ps = ps * z * y + y;
+
+    vfloat pc = vfloat(2.443315711809948E-5f);
+    pc = pc * z - 1.388731625493765E-3f;
+    pc = pc * z + 4.166664568298827E-2f;
+    pc = pc * z * z - 0.5f * z + 1.0f;
+
+    vmask swap = q4 > vfloat(1.0f);
+
+    s = vselect(swap, pc, ps);
+    c = vselect(swap, ps, pc);
+
+    vmask sin_negative = q > vfloat(3.0f);
+    vmask x_negative   = x < vfloat(0.0f);
+    vmask cos_negative = (q > vfloat(1.0f)) & (q < vfloat(5.0f));
+
+    s = vselect(vandnot(sin_negative, x_negative) | vandnot(x_negative, sin_negative), -s, s);
+    c = vselect(cos_negative, -c, c);
+}
+
+template<class vfloat> static inline vfloat simd_length(vfloat x, vfloat y, vfloat z) {
+    return vsqrt(x*x + y*y + z*z);
+}
+
+// Scalar derivative approach by Enforcer
+template<class vfloat> static inline void simd_powN(const CPUMarchParams& params, vfloat& x, vfloat& y, vfloat& z, vfloat zr0, vfloat& dr) {
+
+    vfloat power(params.power);
+
+    //asin(z/r) == atan2(z, length(x,y)) and is better behaved near the poles
+    vfloat zo0 = simd_atan2(z, vsqrt(x*x + y*y));
+    vfloat zi0 = simd_atan2(y, x);
+    vfloat zr  = simd_pow(zr0, power - 1.0f);
+
+    vfloat szo, czo, szi, czi;
+    simd_sincos(zo0 * power, szo, czo);
+    simd_sincos(zi0 * power, szi, czi);
+
+    dr = zr * dr * power + 1.0f;
+    zr = zr * zr0;
+
+    x = zr * czo * czi;
+    y = zr * czo * szi;
+    z = -(zr * szo);
+}
+
+template<class vfloat> static inline void simd_complex_mul(vfloat& ax, vfloat& ay, vfloat bx, vfloat by) {
+    vfloat x = ax*bx - ay*by;
+    ay = ax*by + ay*bx;
+    ax = x;
+}
+
+// trig free powN for whole number powers, see powNInteger in the shader
+template<class vfloat> static inline void simd_powNInteger(const CPUMarchParams& params, vfloat& x, vfloat& y, vfloat& z, vfloat zr0, vfloat& dr) {
+    typedef typename vfloat::mask vmask;
+
+    vfloat zero(0.0f), one(1.0f);
+
+    vfloat rho = vsqrt(x*x + y*y);
+
+    vmask has_rho = rho > zero;
+    vmask has_r   = zr0 > zero;
+
+    vfloat phi_x   = vselect(has_rho, x / rho, one);
+    vfloat phi_y   = vselect(has_rho, y / rho, zero);
+    vfloat theta_x = vselect(has_r, rho / zr0, one);
+    vfloat theta_y = vselect(has_r, z / zr0, zero);
+
+    vfloat phiN_x(1.0f), phiN_y(0.0f), thetaN_x(1.0f), thetaN_y(0.0f), zr(1.0f);
+
+    vfloat phiP_x = phi_x, phiP_y = phi_y, thetaP_x = theta_x, thetaP_y = theta_y, zrP = zr0;
+
+    //the exponent is the same for every lane
+    for (int e = params.int_power - 1; e > 0; e /= 2) {
+        if (e & 1) {
+            simd_complex_mul(phiN_x, phiN_y, phiP_x, phiP_y);
+            simd_complex_mul(thetaN_x, thetaN_y, thetaP_x, thetaP_y);
+            zr = zr * zrP;
+        }
+        simd_complex_mul(phiP_x, phiP_y, phiP_x, phiP_y);
+        simd_complex_mul(thetaP_x, thetaP_y, thetaP_x, thetaP_y);
+        zrP = zrP * zrP;
+    }
+
+    simd_complex_mul(phiN_x, phiN_y, phi_x, phi_y);
+    simd_complex_mul(thetaN_x, thetaN_y, theta_x, theta_y);
+
+    dr = zr * dr * params.power + 1.0f;
+    zr = zr * zr0;
+
+    x = zr * thetaN_x * phiN_x;
+    y = zr * thetaN_x * phiN_y;
+    z = -(zr * thetaN_y);
+}
+
+// distance estimate for the lanes in 'active'; min_dist is only
+// updated for active lanes
+template<class vfloat> static inline vfloat simd_DE(const CPUMarchParams& params, vfloat x, vfloat y, vfloat z, vfloat& min_dist, typename vfloat::mask active) {
+    typedef typename vfloat::mask vmask;
+
+    vfloat cx = params.julia ? vfloat(params.julia_x) : x;
+    vfloat cy = params.julia ? vfloat(params.julia_y) : y;
+    vfloat cz = params.julia ? vfloat(params.julia_z) : z;
+
+    vfloat dr(1.0f);
+    vfloat r = simd_length(x, y, z);
+
+    min_dist = vselect(active, vmin(min_dist, r), min_dist);
+
+    vfloat bailout(params.bailout);
+
+    //lanes still iterating
+    vmask alive = active;
+
+    for (int n = 0; n < params.maxIterations && vany(alive); n++) {
+
+        vfloat nx = x, ny = y, nz = z, ndr = dr;
+
+        if(params.int_power > 0) simd_powNInteger(params, nx, ny, nz, r, ndr);
+        else simd_powN(params, nx, ny, nz, r, ndr);
+
+        nx = nx + cx;
+        ny = ny + cy;
+        nz = nz + cz;
+
+        if(params.pulse) {
+            nx = nx * params.pulse_scale;
+            ny = ny * params.pulse_scale;
+            nz = nz * params.pulse_scale;
+        }
+
+        if(params.radiolaria) ny = vmin(ny, vfloat(params.radiolariaFactor));
+
+        x  = vselect(alive, nx, x);
+        y  = vselect(alive, ny, y);
+        z  = vselect(alive, nz, z);
+        dr = vselect(alive, ndr, dr);
+
+        r = vselect(alive, simd_length(x, y, z), r);
+
+        min_dist = vselect(alive, vmin(min_dist, r), min_dist);
+
+        alive = vandnot(alive, r > bailout);
+    }
+
+    return 0.5f * simd_log2(vmax(r, vfloat(1e-30f))) * SIMD_LN2 * r / dr;
+}
+
+template<class vfloat> static inline void simd_march(const CPUMarchParams& params, CPURayBatch& batch, int base) {
+    typedef typename vfloat::mask vmask;
+
+    vfloat dx = vload(batch.dir_x + base);
+    vfloat dy = vload(batch.dir_y + base);
+    vfloat dz = vload(batch.dir_z + base);
+
+    vfloat ex(params.eye_x), ey(params.eye_y), ez(params.eye_z);
+
+    vmask valid = vfloat::lanes() + (float) base < vfloat((float) batch.count);
+
+    // intersectBoundingSphere
+
+    vfloat b    = ex*dx + ey*dy + ez*dz;
+    vfloat c    = vfloat(params.eye_x*params.eye_x + params.eye_y*params.eye_y + params.eye_z*params.eye_z - params.bounding);
+    vfloat disc = b*b - c;
+
+    vmask hit = valid & (disc > vfloat(0.0f));
+
+    vfloat sdisc = vsqrt(vmax(disc, vfloat(0.0f)));
+    vfloat t0 = -b - sdisc;
+    vfloat t1 = -b + sdisc;
+
+    vmask front = t0 >= vfloat(0.0f);
+
+    vfloat start(0.0f);
+    start = vselect(front, t0, start);
+
+    vfloat unused(4.0f);
+    vfloat tmin = simd_DE(params, ex + start*dx, ey + start*dy, ez + start*dz, unused, hit);
+    vfloat tmax = vselect(front, t0 + t1, t1);
+
+    // renderPixel's march loop
+
+    vfloat px = ex + tmin*dx;
+    vfloat py = ey + tmin*dy;
+    vfloat pz = ez + tmin*dz;
+
+    vfloat dist(4.0f);
+    vfloat min_dist(4.0f);
+    vfloat ray_length = tmin;
+    vfloat eps(SIMD_MIN_EPSILON);
+    vfloat steps((float) params.max_steps);
+
+    vfloat epsilonScale(params.epsilonScale);
+    vfloat pixel_scale(params.pixel_scale);
+
+    vmask active = hit;
+
+    for (int i = 0; i < params.max_steps && vany(active); ++i) {
+
+        dist = vselect(active, simd_DE(params, px, py, pz, min_dist, active), dist);
+
+        vfloat f = vselect(active, epsilonScale * dist, vfloat(0.0f));
+
+        px = px + f * dx;
+        py = py + f * dy;
+        pz = pz + f * dz;
+
+        ray_length = ray_length + f;
+
+        vmask done = active & ((dist < eps) | (ray_length > tmax));
+
+        steps = vselect(done, vfloat((float) i), steps);
+
+        active = vandnot(active, done);
+
+        eps = vselect(active, vmax(vfloat(SIMD_MIN_EPSILON), pixel_scale * ray_length), eps);
+    }
+
+    vstore(batch.hit + base, vselect(hit, vfloat(1.0f), vfloat(0.0f)));
+
+    vstore(batch.pos_x + base, px);
+    vstore(batch.pos_y + base, py);
+    vstore(batch.pos_z + base, pz);
+
+    vstore(batch.ray_length + base, ray_length);
+    vstore(batch.tmax + base,       tmax);
+    vstore(batch.dist + base,       dist);
+    vstore(batch.min_dist + base,   min_dist);
+    vstore(batch.eps + base,        eps);
+    vstore(batch.steps + base,      steps);
+}
+
+template<class vfloat> static void simd_distance_batch(const CPUMarchParams& params, CPUPointBatch& batch) {
+    typedef typename vfloat::mask vmask;
+
+    for(int base = 0; base < batch.count; base += vfloat::width) {
+        vmask valid = vfloat::lanes() + (float) base < vfloat((float) batch.count);
+
+        vfloat min_dist(4.0f);
+
+        vfloat dist = simd_DE(params, vload(batch.x + base), vload(batch.y + base), vload(batch.z + base), min_dist, valid);
+
+        vstore(batch.dist + base, dist);
+    }
+}
+
+template<class vfloat> static void simd_march_batch(const CPUMarchParams& params, CPURayBatch& batch) {
+    for(int base = 0; base < batch.count; base += vfloat::width) {
+        simd_march<vfloat>(params, batch, base);
+    }
+}
+
+#endif
@@ -0,0 +1,109 @@
+/*
+    Copyright (C) 2010 Andrew Caudwell (acaudwell@gmail.com)
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version
+    3 of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "cpu_simd.h"
+
+#ifdef CPU_SIMD_X86
+
+#include <immintrin.h>
+
+#pragma GCC push_options
+#pragma GCC target("sse4.2")
+
+namespace {
+
+class vmask4 {
+public:
+    __m128 m;
+
+    vmask4(__m128 m) : m(m) {}
+};
+
+inline vmask4 operator&(vmask4 a, vmask4 b) { return _mm_and_ps(a.m, b.m); }
+inline vmask4 operator|(vmask4 a, vmask4 b) { return _mm_or_ps(a.m, b.m); }
+
+inline vmask4 vandnot(vmask4 a, vmask4 b) { return _mm_andnot_ps(b.m, a.m); }
+inline bool   vany(vmask4 a) { return _mm_movemask_ps(a.m) != 0; }
+
+class vfloat4 {
+public:
+    __m128 v;
+
+    typedef vmask4 mask;
+    enum { width = 4 };
+
+    vfloat4() {}
+    vfloat4(float f) : v(_mm_set1_ps(f)) {}
+    vfloat4(__m128 v) : v(v) {}
+
+    static vfloat4 lanes() { return _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f); }
+};
+
+inline vfloat4 operator+(vfloat4 a, vfloat4 b) { return _mm_add_ps(a.v, b.v); }
+inline vfloat4 operator-(vfloat4 a, vfloat4 b) { return _mm_sub_ps(a.v, b.v); }
+inline vfloat4 operator*(vfloat4 a, vfloat4 b) { return _mm_mul_ps(a.v, b.v); }
+inline vfloat4 operator/(vfloat4 a, vfloat4 b) { return _mm_div_ps(a.v, b.v); }
+inline vfloat4 operator-(vfloat4 a) { return _mm_xor_ps(a.v, _mm_set1_ps(-0.0f)); }
+
+inline vmask4 operator<(vfloat4 a, vfloat4 b)  { return _mm_cmplt_ps(a.v, b.v); }
+inline vmask4 operator>(vfloat4 a, vfloat4 b)  { return _mm_cmpgt_ps(a.v, b.v); }
+inline vmask4 operator>=(vfloat4 a, vfloat4 b) { return _mm_cmpge_ps(a.v, b.v); }
+
+inline vfloat4 vselect(vmask4 m, vfloat4 a, vfloat4 b) { return _mm_blendv_ps(b.v, a.v, m.m); }
+
+inline vfloat4 vmin(vfloat4 a, vfloat4 b) { return _mm_min_ps(a.v, b.v); }
+inline vfloat4 vmax(vfloat4 a, vfloat4 b) { return _mm_max_ps(a.v, b.v); }
+inline vfloat4 vabs(vfloat4 a)   { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a.v); }
+inline vfloat4 vsqrt(vfloat4 a)  { return _mm_sqrt_ps(a.v); }
+inline vfloat4 vfloor(vfloat4 a) { return _mm_floor_ps(a.v); }
+
+// mantissa in [1,2) and exponent of positive normal numbers
+inline vfloat4 vfrexp(vfloat4 x, vfloat4& e) {
+    __m128i bits = _mm_castps_si128(x.v);
+
+    e = _mm_cvtepi32_ps(_mm_sub_epi32(_mm_srli_epi32(bits, 23), _mm_set1_epi32(127)));
+
+    bits = _mm_and_si128(bits, _mm_set1_epi32(0x007fffff));
+    bits = _mm_or_si128(bits,  _mm_set1_epi32(0x3f800000));
+
+    return _mm_castsi128_ps(bits);
+}
+
+// 2^n for integer n in [-126, 127]
+inline vfloat4 vldexp2(vfloat4 n) {
+    __m128i bits = _mm_add_epi32(_mm_cvtps_epi32(n.v), _mm_set1_epi32(127));
+    return _mm_castsi128_ps(_mm_slli_epi32(bits, 23));
+}
+
+inline vfloat4 vload(const float* p)       { return _mm_loadu_ps(p); }
+inline void    vstore(float* p, vfloat4 a) { _mm_storeu_ps(p, a.v); }
+
+#include "cpu_simd_kernel.h"
+
+}
+
+void cpuMarchSSE42(const CPUMarchParams& params, CPURayBatch& batch) {
+    simd_march_batch<vfloat4>(params, batch);
+}
+
+void cpuDistanceSSE42(const CPUMarchParams& params, CPUPointBatch& batch) {
+    simd_distance_batch<vfloat4>(params, batch);
+}
+
+#pragma GCC pop_options
+
+#endif
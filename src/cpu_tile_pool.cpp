@@ -0,0 +1,334 @@
+/*
+    Copyright (C) 2010 Andrew Caudwell (acaudwell@gmail.com)
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version
+    3 of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "cpu_tile_pool.h"
+
+#include <algorithm>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+extern "C" {
+static int cpu_tile_thread(void *arg) {
+    CPUTileWorker* worker = static_cast<CPUTileWorker *>(arg);
+
+    worker->pool->work(worker);
+
+    return 0;
+}
+};
+
+// CPUTile
+
+CPUTile::CPUTile() {
+    x = y = w = h = 0;
+}
+
+CPUTile::CPUTile(int x, int y, int w, int h) : x(x), y(y), w(w), h(h) {
+}
+
+// CPUTileStats
+
+CPUTileStats::CPUTileStats() {
+    tiles   = 0;
+    stolen  = 0;
+    steals  = 0;
+    busy_ms = 0;
+    idle_ms = 0;
+}
+
+// CPUTileWorker
+
+CPUTileWorker::CPUTileWorker(CPUTilePool* pool, int index) {
+    this->pool  = pool;
+    this->index = index;
+
+    thread = 0;
+    mutex  = SDL_CreateMutex();
+
+    frame_busy_ms = 0;
+    random        = 2463534242u + index * 7919u;
+}
+
+CPUTileWorker::~CPUTileWorker() {
+    SDL_DestroyMutex(mutex);
+}
+
+// CPUTilePool
+
+CPUTilePool::CPUTilePool(int threads, int tile_size) {
+
+    if(threads <= 0) threads = processorCount();
+
+    threads = std::max(1, std::min(CPU_TILE_POOL_MAX_THREADS, threads));
+
+    this->tile_size = std::max(1, tile_size);
+
+    mutex      = SDL_CreateMutex();
+    start_cond = SDL_CreateCond();
+    done_cond  = SDL_CreateCond();
+
+    frame_id     = 0;
+    workers_done = 0;
+    exiting      = false;
+
+    renderer  = 0;
+    rgb       = 0;
+    rowstride = 0;
+
+    for(int i=0;i<threads;i++) {
+        workers.push_back(new CPUTileWorker(this, i));
+    }
+
+    for(int i=0;i<threads;i++) {
+        workers[i]->thread = SDL_CreateThread( cpu_tile_thread, workers[i] );
+    }
+}
+
+CPUTilePool::~CPUTilePool() {
+
+    SDL_mutexP(mutex);
+
+        exiting = true;
+
+    SDL_CondBroadcast(start_cond);
+    SDL_mutexV(mutex);
+
+    for(size_t i=0;i<workers.size();i++) {
+        SDL_WaitThread(workers[i]->thread, 0);
+        delete workers[i];
+    }
+
+    SDL_DestroyCond(start_cond);
+    SDL_DestroyCond(done_cond);
+    SDL_DestroyMutex(mutex);
+}
+
+int CPUTilePool::processorCount() {
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors;
+#else
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (int) count : 1;
+#endif
+}
+
+int CPUTilePool::getThreadCount() const {
+    return workers.size();
+}
+
+const CPUTileStats& CPUTilePool::getStats(int thread) const {
+    return workers[thread]->stats;
+}
+
+void CPUTilePool::printStats(FILE* file) const {
+
+    fprintf(file, "# thread tiles stolen steals busy_ms idle_ms busy_percent\n");
+
+    for(size_t i=0;i<workers.size();i++) {
+        const CPUTileStats& stats = workers[i]->stats;
+
+        Uint32 total_ms = stats.busy_ms + stats.idle_ms;
+
+        fprintf(file, "%d %d %d %d %u %u %.1f\n", (int) i, stats.tiles, stats.stolen, stats.steals,
+            stats.busy_ms, stats.idle_ms, total_ms > 0 ? 100.0f * stats.busy_ms / total_ms : 0.0f);
+    }
+}
+
+void CPUTilePool::render(const CPURenderer& renderer, unsigned char* rgb, size_t rowstride, int width, int height) {
+
+    this->renderer  = &renderer;
+    this->rgb       = rgb;
+    this->rowstride = rowstride;
+
+    int tiles_x = (width  + tile_size - 1) / tile_size;
+    int tiles_y = (height + tile_size - 1) / tile_size;
+
+    int tile_count = tiles_x * tiles_y;
+    int threads    = workers.size();
+
+    //deal the tiles out in contiguous runs, so each thread starts on its own part of the image
+    for(int i=0;i<threads;i++) {
+        CPUTileWorker* worker = workers[i];
+
+        int first = (int) ((long long) tile_count * i / threads);
+        int last  = (int) ((long long) tile_count * (i+1) / threads);
+
+        SDL_mutexP(worker->mutex);
+
+        for(int t = first; t < last; t++) {
+            int tx = t % tiles_x;
+            int ty = t / tiles_x;
+
+            worker->tiles.push_back(CPUTile(tx * tile_size, ty * tile_size, tile_size, tile_size));
+        }
+
+        SDL_mutexV(worker->mutex);
+    }
+
+    Uint32 frame_start = SDL_GetTicks();
+
+    SDL_mutexP(mutex);
+
+        workers_done = 0;
+        frame_id++;
+
+        SDL_CondBroadcast(start_cond);
+
+        while(workers_done < threads) {
+            SDL_CondWait(done_cond, mutex);
+        }
+
+    SDL_mutexV(mutex);
+
+    Uint32 frame_ms = SDL_GetTicks() - frame_start;
+
+    for(int i=0;i<threads;i++) {
+        CPUTileWorker* worker = workers[i];
+
+        worker->stats.busy_ms += worker->frame_busy_ms;
+        worker->stats.idle_ms += frame_ms - std::min(frame_ms, worker->frame_busy_ms);
+    }
+
+    this->renderer = 0;
+}
+
+// the next tile of the worker's own run
+
+bool CPUTilePool::takeTile(CPUTileWorker* worker, CPUTile& tile) {
+
+    bool found = false;
+
+    SDL_mutexP(worker->mutex);
+
+    if(!worker->tiles.empty()) {
+        tile = worker->tiles.front();
+        worker->tiles.pop_front();
+        found = true;
+    }
+
+    SDL_mutexV(worker->mutex);
+
+    return found;
+}
+
+// move half the tiles left to another worker to this one, trying every
+// worker once starting from a random one
+
+bool CPUTilePool::stealTiles(CPUTileWorker* worker) {
+
+    int threads = workers.size();
+
+    if(threads < 2) return false;
+
+    //xorshift
+    worker->random ^= worker->random << 13;
+    worker->random ^= worker->random >> 17;
+    worker->random ^= worker->random << 5;
+
+    int start = worker->random % threads;
+
+    std::vector<CPUTile> stolen;
+
+    for(int i=0;i<threads;i++) {
+        CPUTileWorker* victim = workers[(start + i) % threads];
+
+        if(victim == worker) continue;
+
+        SDL_mutexP(victim->mutex);
+
+        int count = (victim->tiles.size() + 1) / 2;
+
+        //take from the end furthest from where the victim is working
+        for(int t = 0; t < count; t++) {
+            stolen.push_back(victim->tiles.back());
+            victim->tiles.pop_back();
+        }
+
+        SDL_mutexV(victim->mutex);
+
+        if(!stolen.empty()) break;
+    }
+
+    if(stolen.empty()) return false;
+
+    SDL_mutexP(worker->mutex);
+
+    //keep the stolen tiles in image order
+    for(std::vector<CPUTile>::reverse_iterator it = stolen.rbegin(); it != stolen.rend(); it++) {
+        worker->tiles.push_back(*it);
+    }
+
+    SDL_mutexV(worker->mutex);
+
+    worker->stats.steals++;
+    worker->stats.stolen += stolen.size();
+
+    return true;
+}
+
+void CPUTilePool::work(CPUTileWorker* worker) {
+
+    int frame = 0;
+
+    while(true) {
+
+        SDL_mutexP(mutex);
+
+            while(frame_id == frame && !exiting) {
+                SDL_CondWait(start_cond, mutex);
+            }
+
+            if(exiting) {
+                SDL_mutexV(mutex);
+                break;
+            }
+
+            frame = frame_id;
+
+        SDL_mutexV(mutex);
+
+        Uint32 start = SDL_GetTicks();
+
+        CPUTile tile;
+
+        //no tiles are added during a frame, so once there are none
+        //left to take or steal this worker is done with it
+        while(true) {
+            if(!takeTile(worker, tile)) {
+                if(!stealTiles(worker)) break;
+                continue;
+            }
+
+            renderer->renderTile(rgb, rowstride, tile.x, tile.y, tile.w, tile.h);
+            worker->stats.tiles++;
+        }
+
+        worker->frame_busy_ms = SDL_GetTicks() - start;
+
+        SDL_mutexP(mutex);
+
+            workers_done++;
+
+        SDL_CondSignal(done_cond);
+        SDL_mutexV(mutex);
+    }
+}
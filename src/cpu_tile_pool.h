@@ -0,0 +1,132 @@
+/*
+    Copyright (C) 2010 Andrew Caudwell (acaudwell@gmail.com)
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version
+    3 of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef MANDELBULB_CPU_TILE_POOL_H
+#define MANDELBULB_CPU_TILE_POOL_H
+
+#include <deque>
+#include <vector>
+
+#include "SDL.h"
+#include "SDL_thread.h"
+
+#include "cpu_renderer.h"
+
+#define CPU_TILE_SIZE 16
+
+#define CPU_TILE_POOL_MAX_THREADS 256
+
+// an area of the image rendered by one call to CPURenderer::renderTile
+
+class CPUTile {
+public:
+    int x, y;
+    int w, h;
+
+    CPUTile();
+    CPUTile(int x, int y, int w, int h);
+};
+
+// what a thread of the pool did, over all the frames so far
+
+class CPUTileStats {
+public:
+    int tiles;
+    int stolen;
+    int steals;
+
+    //time spent rendering, and waiting for the other threads to finish the frame
+    Uint32 busy_ms;
+    Uint32 idle_ms;
+
+    CPUTileStats();
+};
+
+class CPUTilePool;
+
+class CPUTileWorker {
+public:
+    CPUTilePool* pool;
+    int index;
+
+    SDL_Thread* thread;
+
+    //tiles still to do, the owner takes from the front, thieves from the back
+    SDL_mutex* mutex;
+    std::deque<CPUTile> tiles;
+
+    Uint32 frame_busy_ms;
+    unsigned int random;
+
+    CPUTileStats stats;
+
+    CPUTileWorker(CPUTilePool* pool, int index);
+    ~CPUTileWorker();
+};
+
+// Renders frames with a pool of threads that steal tiles from each other.
+//
+// Pixels that hit the surface cost hundreds of distance estimates while
+// those that miss the bounding sphere cost next to nothing, so splitting
+// the frame evenly between threads leaves most of them waiting for the
+// ones that got the middle of the picture. Each frame is cut into small
+// tiles dealt out to the threads in contiguous runs; a thread that runs
+// out takes half the remaining tiles of another (chosen at random) so all
+// of them stay busy until the frame is done.
+//
+// Each thread has its own lock, so threads only wait on each other while
+// stealing, which lets the pool scale to many cores.
+
+class CPUTilePool {
+    std::vector<CPUTileWorker*> workers;
+
+    int tile_size;
+
+    SDL_mutex* mutex;
+    SDL_cond*  start_cond;
+    SDL_cond*  done_cond;
+
+    int  frame_id;
+    int  workers_done;
+    bool exiting;
+
+    //the frame being rendered
+    const CPURenderer* renderer;
+    unsigned char* rgb;
+    size_t rowstride;
+
+    bool takeTile(CPUTileWorker* worker, CPUTile& tile);
+    bool stealTiles(CPUTileWorker* worker);
+public:
+    // threads = 0 uses one per processor
+    CPUTilePool(int threads = 0, int tile_size = CPU_TILE_SIZE);
+    ~CPUTilePool();
+
+    // render the whole width x height image with renderer
+    void render(const CPURenderer& renderer, unsigned char* rgb, size_t rowstride, int width, int height);
+
+    void work(CPUTileWorker* worker);
+
+    int getThreadCount() const;
+    const CPUTileStats& getStats(int thread) const;
+
+    // write the statistics of each thread to file
+    void printStats(FILE* file) const;
+
+    static int processorCount();
+};
+
+#endif
@@ -0,0 +1,85 @@
+/*
+    Copyright (C) 2010 Andrew Caudwell (acaudwell@gmail.com)
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version
+    3 of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "gpu_timer.h"
+
+GPUTimer::GPUTimer() {
+    next    = 0;
+    pending = 0;
+    running = false;
+
+    for(int i = 0; i < GPU_TIMER_QUERIES; i++) {
+        queries[i] = 0;
+        work[i]    = 0.0f;
+    }
+}
+
+GPUTimer::~GPUTimer() {
+    if(queries[0] != 0) glDeleteQueries(GPU_TIMER_QUERIES, queries);
+}
+
+bool GPUTimer::supported() {
+    return GLEW_VERSION_1_5 && GLEW_EXT_timer_query;
+}
+
+bool GPUTimer::begin(float work) {
+
+    if(running || pending == GPU_TIMER_QUERIES || !supported()) return false;
+
+    if(queries[0] == 0) glGenQueries(GPU_TIMER_QUERIES, queries);
+
+    this->work[next] = work;
+
+    glBeginQuery(GL_TIME_ELAPSED_EXT, queries[next]);
+
+    running = true;
+
+    return true;
+}
+
+void GPUTimer::end() {
+
+    if(!running) return;
+
+    glEndQuery(GL_TIME_ELAPSED_EXT);
+
+    next = (next + 1) % GPU_TIMER_QUERIES;
+    pending++;
+
+    running = false;
+}
+
+bool GPUTimer::getResult(float& ms, float& work) {
+
+    if(pending == 0) return false;
+
+    int query = (next - pending + GPU_TIMER_QUERIES) % GPU_TIMER_QUERIES;
+
+    GLint available = 0;
+    glGetQueryObjectiv(queries[query], GL_QUERY_RESULT_AVAILABLE, &available);
+
+    if(!available) return false;
+
+    GLuint64EXT elapsed = 0;
+    glGetQueryObjectui64vEXT(queries[query], GL_QUERY_RESULT, &elapsed);
+
+    ms   = (float) ((double) elapsed / 1000000.0);
+    work = this->work[query];
+
+    pending--;
+
+    return true;
+}
@@ -0,0 +1,51 @@
+/*
+    Copyright (C) 2010 Andrew Caudwell (acaudwell@gmail.com)
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version
+    3 of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef MANDELBULB_GPU_TIMER_H
+#define MANDELBULB_GPU_TIMER_H
+
+#include "core/display.h"
+
+#define GPU_TIMER_QUERIES 4
+
+// Measures how long the GPU takes to run the commands between begin()
+// and end() using GL_EXT_timer_query. The results are read back frames
+// later, once available, so the pipeline is never stalled waiting for one.
+
+class GPUTimer {
+    GLuint queries[GPU_TIMER_QUERIES];
+    float  work[GPU_TIMER_QUERIES];
+
+    int next;
+    int pending;
+    bool running;
+public:
+    GPUTimer();
+    ~GPUTimer();
+
+    static bool supported();
+
+    // work is returned with the result, eg the number of pixels drawn.
+    // returns false (and times nothing) if every query is still waiting
+    // for its result
+    bool begin(float work);
+    void end();
+
+    // the oldest finished measurement, false if there is none yet
+    bool getResult(float& ms, float& work);
+};
+
+#endif
@@ -0,0 +1,126 @@
+/*
+    Copyright (C) 2010 Andrew Caudwell (acaudwell@gmail.com)
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version
+    3 of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "headless.h"
+
+MandelbulbHeadless::MandelbulbHeadless(ConfFile& conf, int width, int height) {
+    this->width  = width;
+    this->height = height;
+
+    //same starting view and colours as MandelbulbViewer
+    view.setPos(vec3f(0.0, 0.0, 2.6));
+
+    animation.setSeed(gViewerSettings.getSeed());
+
+    if(conf.hasSection("camera")) {
+        campath.load(conf);
+    }
+
+    renderer.setKernel(gViewerSettings.cpu_kernel);
+
+    pool = new CPUTilePool(gViewerSettings.cpu_threads);
+
+    rowstride = width * 3;
+    pixels    = new unsigned char[rowstride * height];
+}
+
+MandelbulbHeadless::~MandelbulbHeadless() {
+    delete pool;
+    delete[] pixels;
+}
+
+void MandelbulbHeadless::renderFrame() {
+
+    animation.update(gViewerSettings, uniforms);
+
+    uniforms.width  = width;
+    uniforms.height = height;
+
+    uniforms.camera       = view.getPos();
+    uniforms.viewRotation = view.getRotationMatrix();
+
+    renderer.setUniforms(uniforms);
+    pool->render(renderer, pixels, rowstride, width, height);
+}
+
+void MandelbulbHeadless::run(std::string outputfile, int framerate) {
+
+    std::ostream* output = &std::cout;
+
+    if(outputfile != "-") {
+        output = new std::ofstream(outputfile.c_str(), std::ios::out | std::ios::binary);
+
+        if(output->fail()) {
+            delete output;
+            throw PPMExporterException(outputfile);
+        }
+    }
+
+    char ppmheader[1024];
+    snprintf(ppmheader, 1024, "P6\n# Generated by %s\n%d %d\n255\n",
+        gSDLAppTitle.c_str(), width, height
+    );
+
+    float dt = (1.0f / (float) framerate) * gViewerSettings.timescale;
+
+    //without a recording render the view described by the conf file
+    bool play = campath.size() > 0;
+
+    if(!gViewerSettings.resolveFrameRange(play ? campath.countFrames(dt) : 0)) {
+        SDLAppQuit("--frame-range and --shard need a recording that doesn't loop");
+    }
+
+    int frame = 0;
+
+    while(true) {
+
+        if(play) {
+            campath.logic(dt, &view);
+            if(campath.isFinished()) break;
+        }
+
+        animation.logic(gViewerSettings, dt, view.getPos());
+
+        frame++;
+
+        if(play) {
+            if(gViewerSettings.frame_last > 0 && frame > gViewerSettings.frame_last) break;
+
+            //frames before the range only advance the state
+            if(frame < gViewerSettings.frame_first) continue;
+        }
+
+        renderFrame();
+
+        *output << ppmheader;
+        output->write((char*) pixels, rowstride * height);
+
+        if(!play) break;
+    }
+
+    output->flush();
+
+    if(gViewerSettings.cpu_stats) {
+        fprintf(stderr, "%s kernel, %d threads\n", cpuKernelName(renderer.getKernel()), pool->getThreadCount());
+        pool->printStats(stderr);
+    }
+
+    if(output != &std::cout) {
+        ((std::ofstream*)output)->close();
+        delete output;
+    }
+}
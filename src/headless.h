@@ -0,0 +1,61 @@
+/*
+    Copyright (C) 2010 Andrew Caudwell (acaudwell@gmail.com)
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version
+    3 of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef MANDELBULB_HEADLESS_H
+#define MANDELBULB_HEADLESS_H
+
+#include "core/pi.h"
+
+#include "viewer_settings.h"
+#include "viewer_uniforms.h"
+#include "cpu_renderer.h"
+#include "cpu_tile_pool.h"
+#include "vcamera.h"
+#include "ppm.h"
+
+// Renders a conf file or recording with the CPU renderer
+// without creating a window or a GL context, spreading each
+// frame over a pool of threads.
+
+class MandelbulbHeadless {
+
+    int width;
+    int height;
+
+    ViewCamera view;
+    ViewCameraPath campath;
+
+    MandelbulbAnimation animation;
+    MandelbulbUniforms uniforms;
+    CPURenderer renderer;
+    CPUTilePool* pool;
+
+    unsigned char* pixels;
+    size_t rowstride;
+
+    void renderFrame();
+public:
+    MandelbulbHeadless(ConfFile& conf, int width, int height);
+    ~MandelbulbHeadless();
+
+    // write each frame of the recording (or the single view of a
+    // conf file) to a PPM stream at the given framerate, limited
+    // to the frame range of the settings
+    void run(std::string outputfile, int framerate);
+};
+
+#endif
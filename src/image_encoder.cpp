@@ -0,0 +1,315 @@
+/*
+    Copyright (C) 2010 Andrew Caudwell (acaudwell@gmail.com)
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version
+    3 of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "image_encoder.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <png.h>
+
+#include <vector>
+
+bool writePNG(const std::string& filename, const unsigned char* rgb, ptrdiff_t stride, int width, int height, int level) {
+
+    FILE* file = fopen(filename.c_str(), "wb");
+
+    if(!file) return false;
+
+    png_structp png_ptr = png_create_write_struct(PNG_LIBPNG_VER_STRING, 0, 0, 0);
+
+    if(!png_ptr) {
+        fclose(file);
+        return false;
+    }
+
+    png_infop info_ptr = png_create_info_struct(png_ptr);
+
+    if(!info_ptr) {
+        png_destroy_write_struct(&png_ptr, 0);
+        fclose(file);
+        return false;
+    }
+
+    //setjmp can't be part of a larger expression
+    if(setjmp(png_jmpbuf(png_ptr))) {
+        png_destroy_write_struct(&png_ptr, &info_ptr);
+        fclose(file);
+        return false;
+    }
+
+    png_init_io(png_ptr, file);
+
+    png_set_compression_level(png_ptr, level);
+
+    //row filtering costs as much as the compression at low levels
+    if(level == 0) {
+        png_set_filter(png_ptr, 0, PNG_FILTER_NONE);
+    } else if(level <= 3) {
+        png_set_filter(png_ptr, 0, PNG_FILTER_SUB);
+    }
+
+    png_set_IHDR(png_ptr, info_ptr, width, height, 8, PNG_COLOR_TYPE_RGB,
+                 PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+
+    png_write_info(png_ptr, info_ptr);
+
+    for(int y=0;y<height;y++) {
+        png_write_row(png_ptr, (png_bytep) (rgb + y * stride));
+    }
+
+    png_write_end(png_ptr, 0);
+
+    png_destroy_write_struct(&png_ptr, &info_ptr);
+
+    return fclose(file) == 0;
+}
+
+// QOI (the 'Quite OK Image' format, see http://qoiformat.org)
+
+enum {
+    QOI_OP_INDEX = 0x00,
+    QOI_OP_DIFF  = 0x40,
+    QOI_OP_LUMA  = 0x80,
+    QOI_OP_RUN   = 0xc0,
+    QOI_OP_RGB   = 0xfe
+};
+
+static void qoiWrite32(std::vector<unsigned char>& out, unsigned int v) {
+    out.push_back(v >> 24);
+    out.push_back(v >> 16);
+    out.push_back(v >> 8);
+    out.push_back(v);
+}
+
+bool writeQOI(const std::string& filename, const unsigned char* rgb, ptrdiff_t stride, int width, int height) {
+
+    std::vector<unsigned char> out;
+
+    //worst case is a QOI_OP_RGB for every pixel
+    out.reserve(14 + width * height * 4 + 8);
+
+    out.push_back('q');
+    out.push_back('o');
+    out.push_back('i');
+    out.push_back('f');
+    qoiWrite32(out, width);
+    qoiWrite32(out, height);
+    out.push_back(3); //channels
+    out.push_back(0); //sRGB with linear alpha
+
+    unsigned char index[64][3];
+    memset(index, 0, sizeof(index));
+
+    //the previous pixel starts as opaque black, alpha is always 255
+    int pr = 0, pg = 0, pb = 0;
+    int run = 0;
+
+    for(int y=0;y<height;y++) {
+
+        const unsigned char* p = rgb + y * stride;
+
+        for(int x=0;x<width;x++, p+=3) {
+            int r = p[0], g = p[1], b = p[2];
+
+            if(r == pr && g == pg && b == pb) {
+                run++;
+
+                if(run == 62) {
+                    out.push_back(QOI_OP_RUN | (run - 1));
+                    run = 0;
+                }
+                continue;
+            }
+
+            if(run > 0) {
+                out.push_back(QOI_OP_RUN | (run - 1));
+                run = 0;
+            }
+
+            int hash = (r * 3 + g * 5 + b * 7 + 255 * 11) % 64;
+
+            if(index[hash][0] == r && index[hash][1] == g && index[hash][2] == b) {
+                out.push_back(QOI_OP_INDEX | hash);
+            } else {
+                index[hash][0] = r;
+                index[hash][1] = g;
+                index[hash][2] = b;
+
+                int dr = (signed char) (r - pr);
+                int dg = (signed char) (g - pg);
+                int db = (signed char) (b - pb);
+
+                int dr_dg = dr - dg;
+                int db_dg = db - dg;
+
+                if(dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1) {
+                    out.push_back(QOI_OP_DIFF | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2));
+
+                } else if(dg >= -32 && dg <= 31 && dr_dg >= -8 && dr_dg <= 7 && db_dg >= -8 && db_dg <= 7) {
+                    out.push_back(QOI_OP_LUMA | (dg + 32));
+                    out.push_back((dr_dg + 8) << 4 | (db_dg + 8));
+
+                } else {
+                    out.push_back(QOI_OP_RGB);
+                    out.push_back(r);
+                    out.push_back(g);
+                    out.push_back(b);
+                }
+            }
+
+            pr = r;
+            pg = g;
+            pb = b;
+        }
+    }
+
+    if(run > 0) out.push_back(QOI_OP_RUN | (run - 1));
+
+    //end marker
+    for(int i=0;i<7;i++) out.push_back(0);
+    out.push_back(1);
+
+    FILE* file = fopen(filename.c_str(), "wb");
+
+    if(!file) return false;
+
+    bool written = fwrite(&out[0], 1, out.size(), file) == out.size();
+
+    return fclose(file) == 0 && written;
+}
+
+// ImageStreamWriter
+
+ImageStreamWriter::ImageStreamWriter() {
+    file     = 0;
+    png_ptr  = 0;
+    info_ptr = 0;
+    width    = 0;
+    height   = 0;
+    rows     = 0;
+}
+
+ImageStreamWriter::~ImageStreamWriter() {
+    close();
+}
+
+bool ImageStreamWriter::open(const std::string& filename, int width, int height, int level) {
+
+    close();
+
+    this->width  = width;
+    this->height = height;
+    this->rows   = 0;
+
+    bool is_png = filename.size() > 4 && filename.substr(filename.size()-4) == ".png";
+
+    file = fopen(filename.c_str(), "wb");
+
+    if(!file) return false;
+
+    if(!is_png) {
+        return fprintf(file, "P6\n%d %d\n255\n", width, height) > 0;
+    }
+
+    png_structp png = png_create_write_struct(PNG_LIBPNG_VER_STRING, 0, 0, 0);
+    png_infop info  = png ? png_create_info_struct(png) : 0;
+
+    png_ptr  = png;
+    info_ptr = info;
+
+    if(!png || !info) {
+        close();
+        return false;
+    }
+
+    //setjmp can't be part of a larger expression
+    if(setjmp(png_jmpbuf(png))) {
+        close();
+        return false;
+    }
+
+    png_init_io(png, file);
+
+    png_set_compression_level(png, level);
+
+    png_set_IHDR(png, info, width, height, 8, PNG_COLOR_TYPE_RGB,
+                 PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+
+    png_write_info(png, info);
+
+    return true;
+}
+
+bool ImageStreamWriter::writeRow(const unsigned char* rgb) {
+
+    if(!file || rows >= height) return false;
+
+    rows++;
+
+    if(!png_ptr) {
+        return fwrite(rgb, 3, width, file) == (size_t) width;
+    }
+
+    png_structp png = (png_structp) png_ptr;
+
+    if(setjmp(png_jmpbuf(png))) return false;
+
+    png_write_row(png, (png_bytep) rgb);
+
+    return true;
+}
+
+// write the end of the PNG, in its own function so nothing else
+// changes between setjmp and a longjmp back to it
+
+bool ImageStreamWriter::writeEnd() {
+
+    png_structp png = (png_structp) png_ptr;
+
+    if(setjmp(png_jmpbuf(png))) return false;
+
+    png_write_end(png, 0);
+
+    return true;
+}
+
+// finish the file, returns false if it is incomplete or could not be written
+
+bool ImageStreamWriter::close() {
+
+    if(!file) return false;
+
+    bool complete = rows == height;
+
+    if(png_ptr != 0) {
+        png_structp png = (png_structp) png_ptr;
+        png_infop info  = (png_infop) info_ptr;
+
+        if(complete) complete = writeEnd();
+
+        png_destroy_write_struct(&png, &info);
+
+        png_ptr  = 0;
+        info_ptr = 0;
+    }
+
+    if(fclose(file) != 0) complete = false;
+
+    file = 0;
+
+    return complete;
+}
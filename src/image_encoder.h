@@ -0,0 +1,63 @@
+/*
+    Copyright (C) 2010 Andrew Caudwell (acaudwell@gmail.com)
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version
+    3 of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef MANDELBULB_IMAGE_ENCODER_H
+#define MANDELBULB_IMAGE_ENCODER_H
+
+#include <stddef.h>
+#include <stdio.h>
+#include <string>
+
+// Write an RGB24 image to a PNG or QOI file.
+//
+// As with the YUV conversion the stride may be negative, so a frame
+// read back from OpenGL can be written the right way up by passing a
+// pointer to its last row.
+
+enum ImageFormat { IMAGE_FORMAT_PNG, IMAGE_FORMAT_QOI };
+
+// level is the zlib compression level (0-9)
+bool writePNG(const std::string& filename, const unsigned char* rgb, ptrdiff_t stride, int width, int height, int level);
+
+// QOI has no compression level, it is always fast
+bool writeQOI(const std::string& filename, const unsigned char* rgb, ptrdiff_t stride, int width, int height);
+
+// Writes an image a row at a time (top row first) so images larger
+// than memory can be streamed to disk. The format (PNG or PPM) is
+// picked from the file extension.
+
+class ImageStreamWriter {
+    FILE* file;
+
+    void* png_ptr;
+    void* info_ptr;
+
+    int width;
+    int height;
+    int rows;
+
+    bool writeEnd();
+public:
+    ImageStreamWriter();
+    ~ImageStreamWriter();
+
+    bool open(const std::string& filename, int width, int height, int level);
+    bool writeRow(const unsigned char* rgb);
+    bool close();
+};
+
+#endif
@@ -17,6 +17,9 @@
 
 #include "ppm.h"
 
+#include <string.h>
+#include <algorithm>
+
 extern "C" {
 static int dumper_thread(void *arg) {
     FrameExporter *e = static_cast<FrameExporter *>(arg);
@@ -27,9 +30,22 @@ static int dumper_thread(void *arg) {
 }
 };
 
+// FrameExporterSlot
+
+FrameExporterSlot::FrameExporterSlot(size_t size) {
+    pixels = new char[size];
+    output = 0;
+    frame  = -1;
+}
+
+FrameExporterSlot::~FrameExporterSlot() {
+    delete[] pixels;
+    delete[] output;
+}
+
 // FrameExporter
 
-FrameExporter::FrameExporter() {
+FrameExporter::FrameExporter(int queue_depth, int writer_threads) {
 
     //this now assumes the display is setup
     //before the frame exporter is created
@@ -37,67 +53,257 @@ FrameExporter::FrameExporter() {
 
     rowstride     = display.width * 3;
 
-    pixels1        = new char[display.height * rowstride];
-    pixels2        = new char[display.height * rowstride];
-    pixels_out     = new char[display.height * rowstride];
+    this->queue_depth = std::max(1, queue_depth);
+
+    for(int i=0;i<this->queue_depth;i++) {
+        slots.push_back(new FrameExporterSlot(display.height * rowstride));
+    }
 
-    pixels_shared_ptr = 0;
+    frames_queued  = 0;
+    frames_taken   = 0;
+    frames_written = 0;
+    exiting        = false;
+
+    peak_depth     = 0;
+    stall_ticks    = 0;
+    dropped_frames = 0;
 
     screentex = display.emptyTexture(display.width, display.height, GL_RGBA);
 
-	dumper_thread_state = FRAME_EXPORTER_WAIT;
+    //read frames back into a ring of pixel buffer objects so the
+    //transfer overlaps with rendering the following frames
+    use_pbos   = GLEW_ARB_pixel_buffer_object;
+    use_fences = use_pbos && GLEW_ARB_sync;
 
-    cond   = SDL_CreateCond();
-    mutex  = SDL_CreateMutex();
-    thread = SDL_CreateThread( dumper_thread, this );
-}
+    pbo_next    = 0;
+    pbo_pending = 0;
 
-FrameExporter::~FrameExporter() {
+    for(int i=0;i<FRAME_EXPORTER_PBO_COUNT;i++) {
+        pbos[i]   = 0;
+        fences[i] = 0;
+    }
 
-    if(dumper_thread_state != FRAME_EXPORTER_EXIT) {
-        SDL_mutexP(mutex);
+    if(use_pbos) {
+        glGenBuffersARB(FRAME_EXPORTER_PBO_COUNT, pbos);
 
-        dumper_thread_state = FRAME_EXPORTER_EXIT;
+        for(int i=0;i<FRAME_EXPORTER_PBO_COUNT;i++) {
+            glBindBufferARB(GL_PIXEL_PACK_BUFFER_ARB, pbos[i]);
+            glBufferDataARB(GL_PIXEL_PACK_BUFFER_ARB, display.height * rowstride, 0, GL_STREAM_READ_ARB);
+        }
 
-        SDL_CondSignal(cond);
-        SDL_mutexV(mutex);
+        glBindBufferARB(GL_PIXEL_PACK_BUFFER_ARB, 0);
     }
 
-    /* wait for thread to quit, then tear down */
-    SDL_KillThread(thread);
-    SDL_DestroyCond(cond);
+    fps_timer  = SDL_GetTicks();
+    fps_frames = 0;
+    export_fps = 0.0f;
+
+    mutex        = SDL_CreateMutex();
+    queue_cond   = SDL_CreateCond();
+    written_cond = SDL_CreateCond();
+
+    writer_threads = std::max(1, std::min(FRAME_EXPORTER_MAX_THREADS, writer_threads));
+
+    for(int i=0;i<writer_threads;i++) {
+        threads.push_back(SDL_CreateThread( dumper_thread, this ));
+    }
+}
+
+FrameExporter::~FrameExporter() {
+
+    stop();
+
+    SDL_DestroyCond(queue_cond);
+    SDL_DestroyCond(written_cond);
     SDL_DestroyMutex(mutex);
 
     if(screentex!=0) glDeleteTextures(1, &screentex);
 
-    pixels_shared_ptr = 0;
+    for(int i=0;i<FRAME_EXPORTER_PBO_COUNT;i++) {
+        if(fences[i] != 0) glDeleteSync(fences[i]);
+    }
+
+    if(use_pbos) glDeleteBuffersARB(FRAME_EXPORTER_PBO_COUNT, pbos);
+
+    for(size_t i=0;i<slots.size();i++) {
+        delete slots[i];
+    }
+}
+
+// write out any queued frames and wait for the writer threads to quit.
+// subclasses call this from their destructor before tearing down their output
 
-    delete[] pixels1;
-    delete[] pixels2;
-    delete[] pixels_out;
+void FrameExporter::stop() {
+
+    if(threads.empty()) return;
+
+    finish();
+
+    SDL_mutexP(mutex);
+
+        exiting = true;
+
+    SDL_CondBroadcast(queue_cond);
+    SDL_mutexV(mutex);
+
+    for(size_t i=0;i<threads.size();i++) {
+        SDL_WaitThread(threads[i], 0);
+    }
+
+    threads.clear();
 }
 
-void FrameExporter::dump() {
+void FrameExporter::dump(const std::string& name) {
 
     display.mode2D();
 
     glEnable(GL_TEXTURE_2D);
     glDisable(GL_BLEND);
 
-    char* next_pixel_ptr = (pixels_shared_ptr == pixels1) ? pixels2 : pixels1;
+    //rows are tightly packed
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+
+    if(!use_pbos) {
+        FrameExporterSlot* slot = acquireSlot(name);
+
+        // copy pixels - now the right way up
+        glReadPixels(0, 0, display.width, display.height,
+            GL_RGB, GL_UNSIGNED_BYTE, slot->pixels);
+
+        queueSlot();
+        return;
+    }
+
+    //ring is full, have to wait for the oldest frame before its buffer is reused
+    if(pbo_pending == FRAME_EXPORTER_PBO_COUNT) collectFrame(true);
+
+    //start an asynchronous read of this frame
+    glBindBufferARB(GL_PIXEL_PACK_BUFFER_ARB, pbos[pbo_next]);
 
-    // copy pixels - now the right way up
     glReadPixels(0, 0, display.width, display.height,
-        GL_RGB, GL_UNSIGNED_BYTE, next_pixel_ptr);
+        GL_RGB, GL_UNSIGNED_BYTE, 0);
+
+    glBindBufferARB(GL_PIXEL_PACK_BUFFER_ARB, 0);
+
+    if(use_fences) fences[pbo_next] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+    pbo_names[pbo_next] = name;
+
+    pbo_next = (pbo_next + 1) % FRAME_EXPORTER_PBO_COUNT;
+    pbo_pending++;
+
+    //pass on any earlier frames the GPU has already finished with
+    while(collectFrame(false));
+}
+
+// pass on frames that have finished reading back without queuing a new one
+
+void FrameExporter::poll() {
+    while(collectFrame(false));
+}
+
+// hand the oldest frame in the ring to the writer threads,
+// returns false if there was none or it is not ready and wait is false
+
+bool FrameExporter::collectFrame(bool wait) {
+
+    if(pbo_pending == 0) return false;
+
+    int pbo = (pbo_next - pbo_pending + FRAME_EXPORTER_PBO_COUNT) % FRAME_EXPORTER_PBO_COUNT;
+
+    if(fences[pbo] != 0) {
+        GLenum result = glClientWaitSync(fences[pbo], GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+
+        if(result == GL_TIMEOUT_EXPIRED) {
+            if(!wait) return false;
+
+            while(result == GL_TIMEOUT_EXPIRED) {
+                result = glClientWaitSync(fences[pbo], 0, 1000000000);
+            }
+        }
+
+        glDeleteSync(fences[pbo]);
+        fences[pbo] = 0;
+
+    } else if(!wait) {
+        //without fences there is no way to tell if the read has completed
+        return false;
+    }
+
+    glBindBufferARB(GL_PIXEL_PACK_BUFFER_ARB, pbos[pbo]);
+
+    char* mapped = (char*) glMapBufferARB(GL_PIXEL_PACK_BUFFER_ARB, GL_READ_ONLY_ARB);
+
+    if(mapped != 0) {
+        FrameExporterSlot* slot = acquireSlot(pbo_names[pbo]);
+
+        memcpy(slot->pixels, mapped, display.height * rowstride);
+        glUnmapBufferARB(GL_PIXEL_PACK_BUFFER_ARB);
+
+        queueSlot();
+    } else {
+        SDL_mutexP(mutex);
+        dropped_frames++;
+        SDL_mutexV(mutex);
+    }
+
+    glBindBufferARB(GL_PIXEL_PACK_BUFFER_ARB, 0);
+
+    pbo_pending--;
+
+    return true;
+}
+
+// wait for the slot of the next frame to be written out (back-pressure)
+
+FrameExporterSlot* FrameExporter::acquireSlot(const std::string& name) {
 
-    // wait for lock before changing the pointer to point to our new buffer
     SDL_mutexP(mutex);
 
-        //flip buffer we are pointing at
-        pixels_shared_ptr = next_pixel_ptr;
-        dumper_thread_state = FRAME_EXPORTER_DUMP;
+    if(frames_queued - frames_written >= queue_depth) {
+
+        Uint32 stall_start = SDL_GetTicks();
+
+        while(frames_queued - frames_written >= queue_depth)
+            SDL_CondWait(written_cond, mutex);
+
+        stall_ticks += SDL_GetTicks() - stall_start;
+    }
+
+    FrameExporterSlot* slot = slots[frames_queued % queue_depth];
+    slot->frame = frames_queued;
+    slot->name  = name;
+
+    SDL_mutexV(mutex);
+
+    return slot;
+}
+
+// pass the slot returned by acquireSlot() to the writer threads
+
+void FrameExporter::queueSlot() {
+
+    SDL_mutexP(mutex);
+
+        frames_queued++;
+
+        peak_depth = std::max(peak_depth, frames_queued - frames_written);
+
+    SDL_CondSignal(queue_cond);
+    SDL_mutexV(mutex);
+}
+
+// wait until every queued frame has been written out
+
+void FrameExporter::finish() {
+
+    while(collectFrame(true));
+
+    SDL_mutexP(mutex);
+
+    while(frames_written < frames_queued)
+        SDL_CondWait(written_cond, mutex);
 
-    SDL_CondSignal(cond);
     SDL_mutexV(mutex);
 }
 
@@ -106,33 +312,103 @@ void FrameExporter::dumpThr() {
     SDL_mutexP(mutex);
 
     for (;;) {
-        while (dumper_thread_state == FRAME_EXPORTER_WAIT)
-            SDL_CondWait(cond, mutex);
+        while (frames_taken == frames_queued && !exiting)
+            SDL_CondWait(queue_cond, mutex);
 
-        if (dumper_thread_state == FRAME_EXPORTER_EXIT) break;
+        if (frames_taken == frames_queued) break;
 
-        if (pixels_shared_ptr != 0) {
+        FrameExporterSlot* slot = slots[frames_taken % queue_depth];
+        frames_taken++;
 
-            //invert image
-            for(int y=0;y<display.height;y++) {
-                for(int x=0;x<rowstride;x++) {
-                    pixels_out[x + y * rowstride] = pixels_shared_ptr[x + (display.height - y - 1) * rowstride];
-                }
-            }
+        //frames can be converted in parallel ...
+        SDL_mutexV(mutex);
 
-            dumpImpl();
-        }
+            convertFrame(slot);
+
+        SDL_mutexP(mutex);
+
+        //... but are written out in order
+        while (frames_written != slot->frame)
+            SDL_CondWait(written_cond, mutex);
+
+        SDL_mutexV(mutex);
+
+            dumpImpl(slot);
+
+        SDL_mutexP(mutex);
+
+        frames_written++;
+
+        SDL_CondBroadcast(written_cond);
 
-        dumper_thread_state = FRAME_EXPORTER_WAIT;
+        fps_frames++;
+
+        Uint32 ticks = SDL_GetTicks();
+
+        if(ticks - fps_timer >= 1000) {
+            export_fps = (float) fps_frames * 1000.0f / (float) (ticks - fps_timer);
+            fps_frames = 0;
+            fps_timer  = ticks;
+        }
     }
 
     SDL_mutexV(mutex);
+}
+
+float FrameExporter::getExportFPS() const {
+    SDL_mutexP(mutex);
+    float fps = export_fps;
+    SDL_mutexV(mutex);
+
+    return fps;
+}
+
+// frames read back by the GPU that poll() has not collected yet
+
+int FrameExporter::getPendingFrames() const {
+    return pbo_pending;
+}
+
+int FrameExporter::getQueueDepth() {
+    SDL_mutexP(mutex);
+    int depth = frames_queued - frames_written;
+    SDL_mutexV(mutex);
+
+    return depth;
+}
+
+int FrameExporter::getQueueCapacity() const {
+    return queue_depth;
+}
+
+int FrameExporter::getPeakQueueDepth() const {
+    SDL_mutexP(mutex);
+    int depth = peak_depth;
+    SDL_mutexV(mutex);
 
+    return depth;
+}
+
+float FrameExporter::getStallTime() const {
+    SDL_mutexP(mutex);
+    Uint32 ticks = stall_ticks;
+    SDL_mutexV(mutex);
+
+    return (float) ticks / 1000.0f;
+}
+
+int FrameExporter::getDroppedFrames() const {
+    SDL_mutexP(mutex);
+    int dropped = dropped_frames;
+    SDL_mutexV(mutex);
+
+    return dropped;
 }
 
 // PPMExporter
 
-PPMExporter::PPMExporter(std::string outputfile) {
+PPMExporter::PPMExporter(std::string outputfile, int queue_depth, int writer_threads)
+    : FrameExporter(queue_depth, writer_threads) {
 
     if(outputfile == "-") {
         output = &std::cout;
@@ -154,19 +430,192 @@ PPMExporter::PPMExporter(std::string outputfile) {
 }
 
 PPMExporter::~PPMExporter() {
-    SDL_mutexP(mutex);
+    stop();
 
-        dumper_thread_state = FRAME_EXPORTER_EXIT;
+    if(filename.size()>0)
+        ((std::fstream*)output)->close();
+}
 
-        SDL_CondSignal(cond);
+void PPMExporter::dumpImpl(FrameExporterSlot* slot) {
+    *output << ppmheader;
 
-    SDL_mutexV(mutex);
+    //write rows straight from the read back frame, last row first
+    for(int y=display.height-1;y>=0;y--) {
+        output->write(slot->pixels + y * rowstride, rowstride);
+    }
+}
+
+// Y4MExporter
+
+Y4MExporter::Y4MExporter(std::string outputfile, int framerate, int queue_depth, int writer_threads, bool header)
+    : FrameExporter(queue_depth, writer_threads) {
+
+    if(outputfile == "-") {
+        output = &std::cout;
+
+    } else {
+        filename = outputfile;
+        output   = new std::ofstream(outputfile.c_str(), std::ios::out | std::ios::binary);
+
+        if(output->fail()) {
+            delete output;
+            throw PPMExporterException(outputfile);
+        }
+    }
+
+    convert    = yuv420Function();
+    frame_size = yuv420Size(display.width, display.height);
+
+    //write stream header
+    if(header) {
+        char y4mheader[1024];
+        snprintf(y4mheader, 1024, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n",
+            display.width, display.height, framerate
+        );
+
+        *output << y4mheader;
+    }
+}
+
+Y4MExporter::~Y4MExporter() {
+    stop();
 
     if(filename.size()>0)
         ((std::fstream*)output)->close();
 }
 
-void PPMExporter::dumpImpl() {
-    *output << ppmheader;
-    output->write(pixels_out, rowstride * display.height);
+void Y4MExporter::convertFrame(FrameExporterSlot* slot) {
+
+    if(slot->output == 0) slot->output = new char[frame_size];
+
+    unsigned char* y = (unsigned char*) slot->output;
+    unsigned char* u = y + display.width * display.height;
+    unsigned char* v = u + ((display.width+1)/2) * ((display.height+1)/2);
+
+    //start from the last row to turn the frame the right way up
+    convert((unsigned char*) slot->pixels + (display.height-1) * rowstride, -((ptrdiff_t) rowstride),
+            display.width, display.height, y, u, v);
+}
+
+void Y4MExporter::dumpImpl(FrameExporterSlot* slot) {
+    *output << "FRAME\n";
+    output->write(slot->output, frame_size);
+}
+
+// ImageSequenceExporter
+
+ImageSequenceExporter::ImageSequenceExporter(std::string pattern, ImageFormat format, int compression, int queue_depth, int writer_threads, int first_frame)
+    : FrameExporter(queue_depth, writer_threads) {
+
+    this->pattern     = pattern;
+    this->format      = format;
+    this->compression = compression;
+    this->first_frame = first_frame;
+}
+
+ImageSequenceExporter::~ImageSequenceExporter() {
+    stop();
+}
+
+void ImageSequenceExporter::convertFrame(FrameExporterSlot* slot) {
+
+    //numbered by position in the sequence, not by which thread finishes first
+    char filename[1024];
+    snprintf(filename, 1024, pattern.c_str(), slot->frame + first_frame);
+
+    const unsigned char* last_row = (unsigned char*) slot->pixels + (display.height-1) * rowstride;
+
+    bool written = false;
+
+    if(format == IMAGE_FORMAT_QOI) {
+        written = writeQOI(filename, last_row, -((ptrdiff_t) rowstride), display.width, display.height);
+    } else {
+        written = writePNG(filename, last_row, -((ptrdiff_t) rowstride), display.width, display.height, compression);
+    }
+
+    if(!written) {
+        debugLog("failed to write %s\n", filename);
+
+        SDL_mutexP(mutex);
+        dropped_frames++;
+        SDL_mutexV(mutex);
+    }
+}
+
+// ScreenshotExporter
+
+ScreenshotExporter::ScreenshotExporter() : FrameExporter(2, 1) {
+    next_index = 1;
+}
+
+ScreenshotExporter::~ScreenshotExporter() {
+    stop();
+}
+
+std::string ScreenshotExporter::screenshot() {
+
+    //continue from the last name used rather than checking every name again
+    char tganame[256] = "";
+    struct stat finfo;
+
+    for(;;) {
+        if(next_index >= 10000) return std::string();
+
+        snprintf(tganame, 256, "screenshot-%04d.tga", next_index++);
+        if(stat(tganame, &finfo) != 0) break;
+    }
+
+    std::string filename(tganame);
+
+    dump(filename);
+
+    //without fences poll() can't tell when the read has finished,
+    //so collect it now rather than when the exporter is finished
+    if(use_pbos && !use_fences) collectFrame(true);
+
+    return filename;
+}
+
+void ScreenshotExporter::convertFrame(FrameExporterSlot* slot) {
+
+    const std::string& filename = slot->name;
+
+    size_t size = display.height * rowstride;
+
+    if(slot->output == 0) slot->output = new char[size];
+
+    //TGA stores BGR
+    for(size_t i=0;i<size;i+=3) {
+        slot->output[i]   = slot->pixels[i+2];
+        slot->output[i+1] = slot->pixels[i+1];
+        slot->output[i+2] = slot->pixels[i];
+    }
+
+    const char tga_header[12] = { 0, 0, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0 };
+    short width           = display.width;
+    short height          = display.height;
+    char  bitsperpixel    = 24;
+    char  imagedescriptor = 0; //rows bottom to top, as read back
+
+    std::ofstream tga;
+    tga.open(filename.c_str(), std::ios::out | std::ios::binary );
+
+    if(tga.is_open()) {
+        tga.write(tga_header, 12);
+        tga.write((char*)&width, sizeof(short));
+        tga.write((char*)&height, sizeof(short));
+        tga.write(&bitsperpixel, 1);
+        tga.write(&imagedescriptor, 1);
+
+        tga.write(slot->output, size);
+        tga.close();
+    }
+
+    if(tga.fail()) {
+        debugLog("failed to write %s\n", filename.c_str());
+
+        SDL_mutexP(mutex);
+        dropped_frames++;
+        SDL_mutexV(mutex);
+    }
 }
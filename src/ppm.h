@@ -21,40 +21,96 @@
 #include <iostream>
 #include <fstream>
 #include <ostream>
+#include <vector>
 
 #include "SDL_thread.h"
 
 #include "core/sdlapp.h"
 #include "core/display.h"
 
-enum { FRAME_EXPORTER_WAIT,
-       FRAME_EXPORTER_DUMP,
-       FRAME_EXPORTER_EXIT };
+#include "yuv420.h"
+#include "image_encoder.h"
 
-class FrameExporter {
-protected:
+//frames read back asynchronously before the oldest has to be collected
+#define FRAME_EXPORTER_PBO_COUNT 3
+
+#define FRAME_EXPORTER_MAX_THREADS 16
 
-    char* pixels1;
-    char* pixels2;
-    char* pixels_out;
+class FrameExporterSlot {
+public:
+    char* pixels; //frame as read back (bottom row first)
+    char* output; //frame prepared by convertFrame() (allocated by the exporter if needed)
+    int frame;
+    std::string name; //as passed to dump()
 
-    char* pixels_shared_ptr;
+    FrameExporterSlot(size_t size);
+    ~FrameExporterSlot();
+};
+
+class FrameExporter {
+protected:
 
     size_t rowstride;
 
     GLuint screentex;
 
-    SDL_Thread* thread;
+    bool use_pbos;
+    bool use_fences;
+
+    GLuint pbos[FRAME_EXPORTER_PBO_COUNT];
+    GLsync fences[FRAME_EXPORTER_PBO_COUNT];
+    std::string pbo_names[FRAME_EXPORTER_PBO_COUNT];
+    int pbo_next;
+    int pbo_pending;
+
+    //frames are queued in order, slot = frame % queue_depth
+    std::vector<FrameExporterSlot*> slots;
+    int queue_depth;
+
+    int frames_queued;  //frames handed to the writer threads
+    int frames_taken;   //frames picked up by a writer thread
+    int frames_written; //frames written out (in order)
+    bool exiting;
+
+    std::vector<SDL_Thread*> threads;
     SDL_mutex* mutex;
-    SDL_cond* cond;
-    int dumper_thread_state;
+    SDL_cond* queue_cond;
+    SDL_cond* written_cond;
+
+    int peak_depth;
+    Uint32 stall_ticks;
+    int dropped_frames;
+
+    Uint32 fps_timer;
+    int fps_frames;
+    float export_fps;
+
+    bool collectFrame(bool wait);
+
+    FrameExporterSlot* acquireSlot(const std::string& name);
+    void queueSlot();
 
+    void stop();
+
+    virtual void convertFrame(FrameExporterSlot* slot) {};
+    virtual void dumpImpl(FrameExporterSlot* slot) {};
 public:
-    FrameExporter();
+    FrameExporter(int queue_depth = 4, int writer_threads = 1);
     virtual ~FrameExporter();
-    void dump();
+    // read back the frame, name is passed on with it to the exporter
+    void dump(const std::string& name = std::string());
     void dumpThr();
-    virtual void dumpImpl() {};
+    void poll();
+    void finish();
+
+    float getExportFPS() const;
+
+    int getPendingFrames() const;
+    int getQueueDepth();
+    int getQueueCapacity() const;
+    int getPeakQueueDepth() const;
+    float getStallTime() const;
+    int getDroppedFrames() const;
 };
 
 class PPMExporterException : public std::exception {
@@ -73,11 +129,65 @@ protected:
     std::string filename;
     char ppmheader[1024];
 
+
+    virtual void dumpImpl(FrameExporterSlot* slot);
 public:
-    PPMExporter(std::string outputfile);
+    PPMExporter(std::string outputfile, int queue_depth = 4, int writer_threads = 1);
     virtual ~PPMExporter();
-    virtual void dumpImpl();
 };
 
+// writes a yuv4mpeg2 stream of 4:2:0 frames, converted by the writer threads
+
+class Y4MExporter : public FrameExporter {
+protected:
+    std::ostream* output;
+    std::string filename;
+
+    YUV420Func convert;
+    size_t frame_size;
+
+    virtual void convertFrame(FrameExporterSlot* slot);
+    virtual void dumpImpl(FrameExporterSlot* slot);
+public:
+    // without a header the stream continues one written before it, so
+    // the parts of a video rendered separately can be concatenated
+    Y4MExporter(std::string outputfile, int framerate, int queue_depth = 4, int writer_threads = 1, bool header = true);
+    virtual ~Y4MExporter();
+};
+
+// writes each frame to a numbered PNG or QOI file, compressing
+// frames concurrently on the writer threads
+
+class ImageSequenceExporter : public FrameExporter {
+protected:
+    std::string pattern;
+    ImageFormat format;
+    int compression;
+    int first_frame;
+
+    virtual void convertFrame(FrameExporterSlot* slot);
+public:
+    // pattern is a printf style file name with the frame number, eg frame-%05d.png,
+    // the first frame written is numbered first_frame
+    ImageSequenceExporter(std::string pattern, ImageFormat format, int compression, int queue_depth = 4, int writer_threads = 4, int first_frame = 1);
+    virtual ~ImageSequenceExporter();
+};
+
+
+// writes screenshots as TGA files in the background
+
+class ScreenshotExporter : public FrameExporter {
+protected:
+    int next_index;
+
+    virtual void convertFrame(FrameExporterSlot* slot);
+public:
+    ScreenshotExporter();
+    virtual ~ScreenshotExporter();
+
+    // queue a screenshot of the back buffer, returns the file it will be written to
+    // (or an empty string if every screenshot name is taken)
+    std::string screenshot();
+};
 
 #endif
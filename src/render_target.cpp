@@ -0,0 +1,164 @@
+/*
+    Copyright (C) 2010 Andrew Caudwell (acaudwell@gmail.com)
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version
+    3 of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "render_target.h"
+
+#include <algorithm>
+
+RenderTarget::RenderTarget(GLenum format, int attachments, GLint filter) {
+    this->format      = format;
+    this->attachments = std::min(attachments, RENDER_TARGET_MAX_ATTACHMENTS);
+    this->filter      = filter;
+
+    fbo     = 0;
+    width   = 0;
+    height  = 0;
+
+    for(int i = 0; i < RENDER_TARGET_MAX_ATTACHMENTS; i++) textures[i] = 0;
+}
+
+RenderTarget::~RenderTarget() {
+    if(fbo != 0) glDeleteFramebuffersEXT(1, &fbo);
+    if(textures[0] != 0) glDeleteTextures(attachments, textures);
+}
+
+bool RenderTarget::supported() {
+    return GLEW_EXT_framebuffer_object;
+}
+
+bool RenderTarget::floatSupported() {
+    return GLEW_EXT_framebuffer_object && GLEW_ARB_texture_float && GLEW_ARB_draw_buffers;
+}
+
+bool RenderTarget::resize(int width, int height) {
+
+    if(textures[0] != 0 && this->width == width && this->height == height) return false;
+
+    this->width  = width;
+    this->height = height;
+
+    if(textures[0] == 0) glGenTextures(attachments, textures);
+    if(fbo == 0)         glGenFramebuffersEXT(1, &fbo);
+
+    bool is_float = format != GL_RGBA8;
+
+    GLenum buffers[RENDER_TARGET_MAX_ATTACHMENTS];
+
+    glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, fbo);
+
+    for(int i = 0; i < attachments; i++) {
+        glBindTexture(GL_TEXTURE_2D, textures[i]);
+
+        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, GL_RGBA, is_float ? GL_FLOAT : GL_UNSIGNED_BYTE, 0);
+
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+        glFramebufferTexture2DEXT(GL_FRAMEBUFFER_EXT, GL_COLOR_ATTACHMENT0_EXT + i, GL_TEXTURE_2D, textures[i], 0);
+
+        buffers[i] = GL_COLOR_ATTACHMENT0_EXT + i;
+    }
+
+    //the draw buffers are remembered by the framebuffer object
+    if(attachments > 1) glDrawBuffersARB(attachments, buffers);
+
+    GLenum status = glCheckFramebufferStatusEXT(GL_FRAMEBUFFER_EXT);
+
+    if(status != GL_FRAMEBUFFER_COMPLETE_EXT) {
+        debugLog("framebuffer %dx%d incomplete (status 0x%x)\n", width, height, status);
+    }
+
+    //start from the clear colour rather than whatever was in video memory
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, 0);
+
+    return true;
+}
+
+void RenderTarget::bind() {
+    glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, fbo);
+
+    glViewport(0, 0, width, height);
+
+    glMatrixMode(GL_PROJECTION);
+    glLoadIdentity();
+    glOrtho(0, width, height, 0, -1.0, 1.0);
+
+    glMatrixMode(GL_MODELVIEW);
+    glLoadIdentity();
+}
+
+void RenderTarget::unbind() {
+    glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, 0);
+
+    glViewport(0, 0, display.width, display.height);
+
+    display.mode2D();
+}
+
+void RenderTarget::clear() {
+    glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, fbo);
+    glClear(GL_COLOR_BUFFER_BIT);
+    glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, 0);
+}
+
+void RenderTarget::draw() {
+    draw(display.width, display.height);
+}
+
+void RenderTarget::draw(int width, int height) {
+
+    glEnable(GL_TEXTURE_2D);
+    glBindTexture(GL_TEXTURE_2D, textures[0]);
+
+    glBegin(GL_QUADS);
+        glTexCoord2i(1,0);
+        glVertex2i(width,height);
+
+        glTexCoord2i(0,0);
+        glVertex2i(0,height);
+
+        glTexCoord2i(0,1);
+        glVertex2i(0,0);
+
+        glTexCoord2i(1,1);
+        glVertex2i(width,0);
+    glEnd();
+}
+
+void RenderTarget::bindTextures() {
+
+    for(int i = attachments-1; i >= 0; i--) {
+        glActiveTextureARB(GL_TEXTURE0_ARB + i);
+        glBindTexture(GL_TEXTURE_2D, textures[i]);
+    }
+}
+
+GLuint RenderTarget::getTexture(int attachment) const {
+    return textures[attachment];
+}
+
+int RenderTarget::getWidth() const {
+    return width;
+}
+
+int RenderTarget::getHeight() const {
+    return height;
+}
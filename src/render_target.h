@@ -0,0 +1,75 @@
+/*
+    Copyright (C) 2010 Andrew Caudwell (acaudwell@gmail.com)
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version
+    3 of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef MANDELBULB_RENDER_TARGET_H
+#define MANDELBULB_RENDER_TARGET_H
+
+#include "core/display.h"
+
+#define RENDER_TARGET_MAX_ATTACHMENTS 4
+
+// RGBA textures attached to a framebuffer object,
+// so a pass can be rendered directly into a texture.
+// With more than one attachment a shader writes each with gl_FragData[n].
+
+class RenderTarget {
+    GLuint fbo;
+    GLuint textures[RENDER_TARGET_MAX_ATTACHMENTS];
+
+    GLenum format;
+    int attachments;
+    GLint filter;
+
+    int width;
+    int height;
+public:
+    // filter is how the textures are sampled, GL_NEAREST for data that
+    // can't be blended (like the positions and normals of a G-buffer)
+    RenderTarget(GLenum format = GL_RGBA8, int attachments = 1, GLint filter = GL_LINEAR);
+    ~RenderTarget();
+
+    static bool supported();
+
+    // float formats and multiple attachments (for a G-buffer)
+    static bool floatSupported();
+
+    // (re)allocates the attachment if the size changed, returns true if it did
+    bool resize(int width, int height);
+
+    // render into the target with a 2D projection matching its size
+    void bind();
+
+    // render to the window again
+    static void unbind();
+
+    void clear();
+
+    // draw the target texture stretched over the window
+    void draw();
+
+    // draw the target texture stretched over an area of the given size
+    void draw(int width, int height);
+
+    // bind attachment n to texture unit n for a shader to sample
+    void bindTextures();
+
+    GLuint getTexture(int attachment = 0) const;
+    int getWidth() const;
+    int getHeight() const;
+};
+
+#endif
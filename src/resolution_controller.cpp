@@ -0,0 +1,83 @@
+/*
+    Copyright (C) 2010 Andrew Caudwell (acaudwell@gmail.com)
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version
+    3 of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "resolution_controller.h"
+
+#include <algorithm>
+#include <cmath>
+
+ResolutionController::ResolutionController(float target_fps, float min_scale) {
+    this->min_scale = min_scale;
+
+    scale      = 1.0f;
+    pixel_ms   = -1.0f;
+    still_time = 0.0f;
+
+    setTargetFPS(target_fps);
+}
+
+void ResolutionController::setTargetFPS(float fps) {
+    target_ms = 1000.0f / fps;
+}
+
+void ResolutionController::addMeasurement(float ms, float pixels) {
+
+    if(pixels <= 0.0f || ms <= 0.0f) return;
+
+    float sample = ms / pixels;
+
+    //the cost depends on what is on screen, so follow it but smooth out the noise
+    pixel_ms = pixel_ms < 0.0f ? sample : pixel_ms * 0.7f + sample * 0.3f;
+}
+
+void ResolutionController::update(float dt, bool moving, float full_pixels) {
+
+    if(!moving) {
+        still_time += dt;
+
+        if(still_time >= RESOLUTION_STILL_DELAY) scale = 1.0f;
+
+        return;
+    }
+
+    still_time = 0.0f;
+
+    if(pixel_ms < 0.0f || full_pixels <= 0.0f) return;
+
+    //cost is proportional to the number of pixels, ie the square of the scale
+    float ideal = sqrtf(target_ms / (pixel_ms * full_pixels));
+
+    ideal = std::max(min_scale, std::min(1.0f, ideal));
+    ideal = std::max(min_scale, floorf(ideal / RESOLUTION_SCALE_STEP) * RESOLUTION_SCALE_STEP);
+
+    float predicted_ms = getFrameTime(full_pixels);
+
+    if(predicted_ms > target_ms * 1.1f) {
+        scale = std::min(scale, ideal);
+    } else if(predicted_ms < target_ms * 0.75f && ideal > scale) {
+        scale = std::min(ideal, scale + RESOLUTION_SCALE_STEP);
+    }
+}
+
+float ResolutionController::getScale() const {
+    return scale;
+}
+
+float ResolutionController::getFrameTime(float full_pixels) const {
+    if(pixel_ms < 0.0f) return 0.0f;
+
+    return pixel_ms * full_pixels * scale * scale;
+}
@@ -0,0 +1,62 @@
+/*
+    Copyright (C) 2010 Andrew Caudwell (acaudwell@gmail.com)
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version
+    3 of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef MANDELBULB_RESOLUTION_CONTROLLER_H
+#define MANDELBULB_RESOLUTION_CONTROLLER_H
+
+//the scale moves in steps of this size, so small changes in the
+//measurements don't reallocate the render targets every frame
+#define RESOLUTION_SCALE_STEP 0.05f
+
+//seconds the camera must be still before going back to full resolution
+#define RESOLUTION_STILL_DELAY 0.25f
+
+// Picks the fraction of the full size the fractal is rendered at.
+//
+// While the camera moves the scale follows the measured cost per pixel
+// so a whole frame takes about the target time: it drops in one step when
+// over budget but only creeps back up, and nothing changes while the
+// predicted time is within a band around the target. Once the camera is
+// still it returns to full resolution.
+
+class ResolutionController {
+    float scale;
+    float min_scale;
+
+    float target_ms;
+
+    //filtered GPU time per pixel, negative until measured
+    float pixel_ms;
+
+    float still_time;
+public:
+    ResolutionController(float target_fps = 30.0f, float min_scale = 0.25f);
+
+    void setTargetFPS(float fps);
+
+    // a frame (or part of one) took ms to draw the given number of pixels
+    void addMeasurement(float ms, float pixels);
+
+    // choose the scale for the next frame, full_pixels at a scale of 1.0
+    void update(float dt, bool moving, float full_pixels);
+
+    float getScale() const;
+
+    // predicted time of a whole frame at the current scale
+    float getFrameTime(float full_pixels) const;
+};
+
+#endif
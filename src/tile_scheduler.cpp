@@ -0,0 +1,394 @@
+/*
+    Copyright (C) 2010 Andrew Caudwell (acaudwell@gmail.com)
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version
+    3 of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "tile_scheduler.h"
+
+#include <algorithm>
+#include <cmath>
+
+RenderTile::RenderTile() {
+    x = y = w = h = 0;
+}
+
+RenderTile::RenderTile(int x, int y, int w, int h) : x(x), y(y), w(w), h(h) {
+}
+
+// position of (x,y) along a Hilbert curve filling an n x n grid (n a power of 2)
+static int hilbertIndex(int n, int x, int y) {
+
+    int d = 0;
+
+    for(int s = n/2; s > 0; s /= 2) {
+        int rx = (x & s) > 0;
+        int ry = (y & s) > 0;
+
+        d += s * s * ((3 * rx) ^ ry);
+
+        //rotate the quadrant so the curve joins up
+        if(ry == 0) {
+            if(rx == 1) {
+                x = n-1 - x;
+                y = n-1 - y;
+            }
+            std::swap(x, y);
+        }
+    }
+
+    return d;
+}
+
+TileScheduler::TileScheduler(int tile_size, TileOrder order) {
+    this->order = order;
+
+    width  = 0;
+    height = 0;
+
+    cell_size = 1;
+    cells_x   = 0;
+    cells_y   = 0;
+
+    pixel_ms = -1.0f;
+    error_ms = 0.0f;
+
+    last_predicted_ms = 0.0f;
+
+    next   = 0;
+    active = false;
+
+    log = 0;
+    batch_count = 0;
+
+    setTileSize(tile_size);
+}
+
+void TileScheduler::setTileSize(int tile_size) {
+    this->tile_size = std::max(1, tile_size);
+
+    //forget the costs measured with the old cells
+    width = height = 0;
+}
+
+void TileScheduler::setOrder(TileOrder order) {
+    this->order = order;
+}
+
+void TileScheduler::setLog(FILE* log) {
+    this->log = log;
+
+    if(log != 0) {
+        fprintf(log, "# batch tiles pixels predicted_ms measured_ms error_ms\n");
+    }
+}
+
+void TileScheduler::resize(int width, int height) {
+
+    if(width == this->width && height == this->height) return;
+
+    this->width  = width;
+    this->height = height;
+
+    //tiles split at most twice
+    cell_size = std::max(1, tile_size / 4);
+
+    cells_x = (width  + cell_size - 1) / cell_size;
+    cells_y = (height + cell_size - 1) / cell_size;
+
+    cell_ms.assign(cells_x * cells_y, -1.0f);
+}
+
+int TileScheduler::cellArea(int cx, int cy) const {
+    return std::min(cell_size, width - cx * cell_size) * std::min(cell_size, height - cy * cell_size);
+}
+
+float TileScheduler::predictTile(const RenderTile& tile) const {
+
+    float ms = 0.0f;
+
+    int cx1 = (tile.x + tile.w + cell_size - 1) / cell_size;
+    int cy1 = (tile.y + tile.h + cell_size - 1) / cell_size;
+
+    for(int cy = tile.y / cell_size; cy < cy1 && cy < cells_y; cy++) {
+        for(int cx = tile.x / cell_size; cx < cx1 && cx < cells_x; cx++) {
+            float cell = cell_ms[cy * cells_x + cx];
+
+            if(cell >= 0.0f)            ms += cell;
+            else if(hasMeasurements()) ms += pixel_ms * cellArea(cx, cy);
+        }
+    }
+
+    return ms;
+}
+
+void TileScheduler::addTile(std::vector<RenderTile>& out, const RenderTile& tile, float split_ms) const {
+
+    if(split_ms <= 0.0f || tile.w <= cell_size || tile.h <= cell_size || predictTile(tile) <= split_ms) {
+        out.push_back(tile);
+        return;
+    }
+
+    int half_w = (tile.w + 1) / 2;
+    int half_h = (tile.h + 1) / 2;
+
+    //quadrants in the order a Hilbert curve visits them
+    RenderTile children[4] = {
+        RenderTile(tile.x,          tile.y,          half_w,          half_h),
+        RenderTile(tile.x,          tile.y + half_h, half_w,          tile.h - half_h),
+        RenderTile(tile.x + half_w, tile.y + half_h, tile.w - half_w, tile.h - half_h),
+        RenderTile(tile.x + half_w, tile.y,          tile.w - half_w, half_h)
+    };
+
+    std::vector< std::pair<float, int> > keys;
+
+    for(int i = 0; i < 4; i++) {
+        float key = (float) i;
+
+        if(order == TILE_ORDER_CENTRE) {
+            float dx = children[i].x + children[i].w * 0.5f - width  * 0.5f;
+            float dy = children[i].y + children[i].h * 0.5f - height * 0.5f;
+            key = dx*dx + dy*dy;
+        }
+
+        keys.push_back(std::make_pair(key, i));
+    }
+
+    std::sort(keys.begin(), keys.end());
+
+    for(int i = 0; i < 4; i++) addTile(out, children[keys[i].second], split_ms);
+}
+
+void TileScheduler::restart() {
+    active = false;
+    next   = 0;
+}
+
+void TileScheduler::build(int width, int height, float budget_ms) {
+
+    if(active) return;
+
+    resize(width, height);
+
+    int tiles_x = (width  + tile_size - 1) / tile_size;
+    int tiles_y = (height + tile_size - 1) / tile_size;
+
+    int n = 1;
+    while(n < tiles_x || n < tiles_y) n *= 2;
+
+    std::vector< std::pair<float, int> > keys;
+
+    for(int ty = 0; ty < tiles_y; ty++) {
+        for(int tx = 0; tx < tiles_x; tx++) {
+            float key;
+
+            if(order == TILE_ORDER_HILBERT) {
+                key = (float) hilbertIndex(n, tx, ty);
+            } else {
+                float dx = (tx + 0.5f) * tile_size - width  * 0.5f;
+                float dy = (ty + 0.5f) * tile_size - height * 0.5f;
+                key = dx*dx + dy*dy;
+            }
+
+            keys.push_back(std::make_pair(key, ty * tiles_x + tx));
+        }
+    }
+
+    std::sort(keys.begin(), keys.end());
+
+    //split the tiles that were expensive last time
+    float split_ms = hasMeasurements() ? budget_ms * 0.5f : 0.0f;
+
+    tiles.clear();
+
+    for(size_t i = 0; i < keys.size(); i++) {
+        int tx = keys[i].second % tiles_x;
+        int ty = keys[i].second / tiles_x;
+
+        RenderTile tile(tx * tile_size, ty * tile_size,
+                        std::min(tile_size, width  - tx * tile_size),
+                        std::min(tile_size, height - ty * tile_size));
+
+        addTile(tiles, tile, split_ms);
+    }
+
+    next   = 0;
+    active = true;
+}
+
+void TileScheduler::finish() {
+    active = true;
+    next   = tiles.size();
+}
+
+bool TileScheduler::started() const {
+    return active && next > 0;
+}
+
+bool TileScheduler::finished() const {
+    return active && next >= tiles.size();
+}
+
+int TileScheduler::getTileCount() const {
+    return tiles.size();
+}
+
+int TileScheduler::getTilesDone() const {
+    return std::min(next, tiles.size());
+}
+
+bool TileScheduler::hasMeasurements() const {
+    return pixel_ms >= 0.0f;
+}
+
+void TileScheduler::nextBatch(float budget_ms, std::vector<RenderTile>& batch) {
+
+    batch.clear();
+
+    float ms = 0.0f;
+
+    //add tiles while the prediction (allowing for its usual error) fits
+    while(next < tiles.size()) {
+        float tile_ms = predictTile(tiles[next]);
+
+        if(!batch.empty() && ms + tile_ms + error_ms > budget_ms) break;
+
+        batch.push_back(tiles[next++]);
+        ms += tile_ms;
+    }
+
+    last_predicted_ms = ms;
+}
+
+void TileScheduler::nextBatch(int count, std::vector<RenderTile>& batch) {
+
+    batch.clear();
+
+    while(next < tiles.size() && (int) batch.size() < std::max(1, count)) {
+        batch.push_back(tiles[next++]);
+    }
+}
+
+void TileScheduler::issued(const std::vector<RenderTile>& batch, int width, int height) {
+
+    resize(width, height);
+
+    TileBatch timed;
+    timed.tiles  = batch;
+    timed.width  = width;
+    timed.height = height;
+
+    timed.predicted_ms = 0.0f;
+
+    if(hasMeasurements()) {
+        for(size_t i = 0; i < batch.size(); i++) timed.predicted_ms += predictTile(batch[i]);
+    }
+
+    in_flight.push_back(timed);
+}
+
+void TileScheduler::addMeasurement(float ms) {
+
+    if(in_flight.empty()) return;
+
+    TileBatch batch = in_flight.front();
+    in_flight.pop_front();
+
+    int pixels = 0;
+
+    for(size_t i = 0; i < batch.tiles.size(); i++) pixels += batch.tiles[i].w * batch.tiles[i].h;
+
+    if(pixels <= 0) return;
+
+    bool predicted = hasMeasurements();
+
+    float error = ms - batch.predicted_ms;
+
+    if(log != 0) {
+        fprintf(log, "%d %d %d %.3f %.3f %.3f\n", batch_count, (int) batch.tiles.size(), pixels,
+            batch.predicted_ms, ms, predicted ? error : 0.0f);
+    }
+
+    batch_count++;
+
+    float sample = ms / pixels;
+
+    pixel_ms = pixel_ms < 0.0f ? sample : pixel_ms * 0.8f + sample * 0.2f;
+
+    if(predicted) error_ms = error_ms * 0.8f + fabsf(error) * 0.2f;
+
+    if(batch.width != width || batch.height != height) return;
+
+    //tiles split off the middle of a cell share it, so each cell is counted once
+    std::vector<int> cells;
+
+    for(size_t i = 0; i < batch.tiles.size(); i++) {
+        const RenderTile& tile = batch.tiles[i];
+
+        for(int cy = tile.y / cell_size; cy * cell_size < tile.y + tile.h; cy++) {
+            for(int cx = tile.x / cell_size; cx * cell_size < tile.x + tile.w; cx++) {
+                cells.push_back(cy * cells_x + cx);
+            }
+        }
+    }
+
+    std::sort(cells.begin(), cells.end());
+    cells.erase(std::unique(cells.begin(), cells.end()), cells.end());
+
+    //cells measured before keep their relative cost, so a batch
+    //covering cheap and expensive areas doesn't flatten them
+    float profile_ms = 0.0f;
+    bool  profiled   = true;
+
+    for(size_t i = 0; i < cells.size(); i++) {
+        float cell = cell_ms[cells[i]];
+
+        if(cell < 0.0f) profiled = false;
+        else profile_ms += cell;
+    }
+
+    float scale = (profiled && profile_ms > 0.0f) ? ms / profile_ms : 0.0f;
+
+    for(size_t i = 0; i < cells.size(); i++) {
+        float& cell = cell_ms[cells[i]];
+
+        cell = scale > 0.0f ? cell * scale : sample * cellArea(cells[i] % cells_x, cells[i] / cells_x);
+    }
+}
+
+const std::deque<TileBatch>& TileScheduler::getInFlight() const {
+    return in_flight;
+}
+
+float TileScheduler::getPrediction() const {
+    return last_predicted_ms;
+}
+
+float TileScheduler::getError() const {
+    return error_ms;
+}
+
+bool TileScheduler::orderFromName(const std::string& name, TileOrder& order) {
+
+    if(name == "centre" || name == "center") {
+        order = TILE_ORDER_CENTRE;
+        return true;
+    }
+
+    if(name == "hilbert") {
+        order = TILE_ORDER_HILBERT;
+        return true;
+    }
+
+    return false;
+}
@@ -0,0 +1,142 @@
+/*
+    Copyright (C) 2010 Andrew Caudwell (acaudwell@gmail.com)
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version
+    3 of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef MANDELBULB_TILE_SCHEDULER_H
+#define MANDELBULB_TILE_SCHEDULER_H
+
+#include <stdio.h>
+
+#include <deque>
+#include <string>
+#include <vector>
+
+enum TileOrder {
+    TILE_ORDER_CENTRE,
+    TILE_ORDER_HILBERT
+};
+
+// an area of the frame, with y down from the top
+class RenderTile {
+public:
+    int x, y;
+    int w, h;
+
+    RenderTile();
+    RenderTile(int x, int y, int w, int h);
+};
+
+// tiles drawn in one timed pass
+class TileBatch {
+public:
+    std::vector<RenderTile> tiles;
+    int width;
+    int height;
+    float predicted_ms;
+};
+
+// Splits a frame drawn over several updates into tiles and decides which
+// are drawn next.
+//
+// Tiles are ordered centre first (or along a Hilbert curve) so the middle
+// of the picture, where the interesting part usually is, is finished
+// first. The GPU time of each batch is spread over a grid of cells a
+// quarter of the tile size, giving the cost of every part of the frame
+// as last drawn. Batches are filled up to a time budget from that, and
+// tiles predicted to take more than half of it are split in four so no
+// single tile blows the budget.
+//
+// Measurements arrive a few frames late, in the order the batches were issued.
+
+class TileScheduler {
+    int tile_size;
+    TileOrder order;
+
+    int width;
+    int height;
+
+    int cell_size;
+    int cells_x;
+    int cells_y;
+    std::vector<float> cell_ms;
+
+    //filtered cost per pixel and how far off the predictions are
+    float pixel_ms;
+    float error_ms;
+    float last_predicted_ms;
+
+    std::vector<RenderTile> tiles;
+    size_t next;
+    bool active;
+
+    std::deque<TileBatch> in_flight;
+
+    FILE* log;
+    int batch_count;
+
+    void resize(int width, int height);
+
+    int cellArea(int cx, int cy) const;
+    float predictTile(const RenderTile& tile) const;
+
+    void addTile(std::vector<RenderTile>& out, const RenderTile& tile, float split_ms) const;
+public:
+    TileScheduler(int tile_size = 64, TileOrder order = TILE_ORDER_CENTRE);
+
+    void setTileSize(int tile_size);
+    void setOrder(TileOrder order);
+
+    // write each prediction and measurement to a file (0 for none)
+    void setLog(FILE* log);
+
+    // the next frame starts over from the first tile
+    void restart();
+
+    // lay out the tiles of a frame unless one is in progress
+    void build(int width, int height, float budget_ms);
+
+    // mark the frame as done without drawing the remaining tiles
+    void finish();
+
+    bool started() const;
+    bool finished() const;
+
+    int getTileCount() const;
+    int getTilesDone() const;
+
+    bool hasMeasurements() const;
+
+    // the next tiles, predicted to take about budget_ms (at least one)
+    void nextBatch(float budget_ms, std::vector<RenderTile>& batch);
+
+    // the next count tiles
+    void nextBatch(int count, std::vector<RenderTile>& batch);
+
+    // a pass over the tiles was timed, the result is given to addMeasurement
+    void issued(const std::vector<RenderTile>& batch, int width, int height);
+
+    // the measurement of the oldest issued pass
+    void addMeasurement(float ms);
+
+    // passes waiting for their measurement
+    const std::deque<TileBatch>& getInFlight() const;
+
+    float getPrediction() const;
+    float getError() const;
+
+    static bool orderFromName(const std::string& name, TileOrder& order);
+};
+
+#endif
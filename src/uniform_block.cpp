@@ -0,0 +1,194 @@
+/*
+    Copyright (C) 2010 Andrew Caudwell (acaudwell@gmail.com)
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version
+    3 of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "uniform_block.h"
+
+#include <cstring>
+
+static const char* uniform_names[UNIFORM_COUNT] = {
+    "width",
+    "height",
+    "camera",
+    "cameraFine",
+    "cameraZoom",
+    "julia",
+    "julia_c",
+    "radiolaria",
+    "radiolariaFactor",
+    "power",
+    "intPower",
+    "bounding",
+    "bailout",
+    "antialiasing",
+    "phong",
+    "shadows",
+    "ambientOcclusion",
+    "ambientOcclusionEmphasis",
+    "colorSpread",
+    "rimLight",
+    "specularity",
+    "specularExponent",
+    "light",
+    "backgroundColor",
+    "diffuseColor",
+    "ambientColor",
+    "lightColor",
+    "viewRotation",
+    "objRotation",
+    "maxIterations",
+    "stepLimit",
+    "epsilonScale",
+    "aoSteps",
+    "fogDistance",
+    "render_depth",
+    "glowDepth",
+    "glowMulti",
+    "Rave",
+    "Pulse",
+    "PulseScale",
+    "glowColour",
+    "backgroundGradient",
+    "fov"
+};
+
+MandelbulbUniformBlock::MandelbulbUniformBlock(Shader* shader) {
+    this->shader = shader;
+
+    for(int i = 0; i < UNIFORM_COUNT; i++) {
+        locations[i] = shader->getUniformLocation(uniform_names[i]);
+    }
+
+    uploaded     = false;
+    upload_count = 0;
+}
+
+Shader* MandelbulbUniformBlock::getShader() {
+    return shader;
+}
+
+void MandelbulbUniformBlock::invalidate() {
+    uploaded = false;
+}
+
+void MandelbulbUniformBlock::setFloat(int id, float value, float previous) {
+    if(locations[id] == -1 || (uploaded && value == previous)) return;
+
+    glUniform1fARB(locations[id], value);
+    upload_count++;
+}
+
+void MandelbulbUniformBlock::setInteger(int id, int value, int previous) {
+    if(locations[id] == -1 || (uploaded && value == previous)) return;
+
+    glUniform1iARB(locations[id], value);
+    upload_count++;
+}
+
+void MandelbulbUniformBlock::setVec3(int id, const vec3f& value, const vec3f& previous) {
+    if(locations[id] == -1 || (uploaded && !memcmp(&value, &previous, sizeof(vec3f)))) return;
+
+    glUniform3fvARB(locations[id], 1, value);
+    upload_count++;
+}
+
+void MandelbulbUniformBlock::setVec4(int id, const vec4f& value, const vec4f& previous) {
+    if(locations[id] == -1 || (uploaded && !memcmp(&value, &previous, sizeof(vec4f)))) return;
+
+    glUniform4fvARB(locations[id], 1, value);
+    upload_count++;
+}
+
+void MandelbulbUniformBlock::setMat3(int id, const mat3f& value, const mat3f& previous) {
+    if(locations[id] == -1 || (uploaded && !memcmp(&value, &previous, sizeof(mat3f)))) return;
+
+    glUniformMatrix3fvARB(locations[id], 1, 0, value);
+    upload_count++;
+}
+
+int MandelbulbUniformBlock::upload(const MandelbulbUniforms& u) {
+
+    upload_count = 0;
+
+    setFloat(UNIFORM_WIDTH,  u.width,  last.width);
+    setFloat(UNIFORM_HEIGHT, u.height, last.height);
+
+    setVec3 (UNIFORM_CAMERA,      u.camera,     last.camera);
+    setVec3 (UNIFORM_CAMERA_FINE, u.cameraFine, last.cameraFine);
+    setFloat(UNIFORM_CAMERA_ZOOM, u.cameraZoom, last.cameraZoom);
+
+    setInteger(UNIFORM_JULIA, u.julia,   last.julia);
+    setVec3 (UNIFORM_JULIA_C, u.julia_c, last.julia_c);
+
+    setInteger(UNIFORM_RADIOLARIA,      u.radiolaria,       last.radiolaria);
+    setFloat  (UNIFORM_RADIOLARIA_FACTOR, u.radiolariaFactor, last.radiolariaFactor);
+
+    setFloat  (UNIFORM_POWER,     u.power,    last.power);
+    setInteger(UNIFORM_INT_POWER, u.intPower, last.intPower);
+
+    setFloat(UNIFORM_BOUNDING, u.bounding, last.bounding);
+    setFloat(UNIFORM_BAILOUT,  u.bailout,  last.bailout);
+
+    setInteger(UNIFORM_ANTIALIASING, u.antialiasing, last.antialiasing);
+
+    setInteger(UNIFORM_PHONG, u.phong,   last.phong);
+    setFloat  (UNIFORM_SHADOWS, u.shadows, last.shadows);
+
+    setFloat(UNIFORM_AMBIENT_OCCLUSION,          u.ambientOcclusion,         last.ambientOcclusion);
+    setFloat(UNIFORM_AMBIENT_OCCLUSION_EMPHASIS, u.ambientOcclusionEmphasis, last.ambientOcclusionEmphasis);
+
+    setFloat(UNIFORM_COLOR_SPREAD,      u.colorSpread,      last.colorSpread);
+    setFloat(UNIFORM_RIM_LIGHT,         u.rimLight,         last.rimLight);
+    setFloat(UNIFORM_SPECULARITY,       u.specularity,      last.specularity);
+    setFloat(UNIFORM_SPECULAR_EXPONENT, u.specularExponent, last.specularExponent);
+
+    setVec3(UNIFORM_LIGHT, u.light, last.light);
+
+    setVec4(UNIFORM_BACKGROUND_COLOR, u.backgroundColor, last.backgroundColor);
+    setVec4(UNIFORM_DIFFUSE_COLOR,    u.diffuseColor,    last.diffuseColor);
+    setVec4(UNIFORM_AMBIENT_COLOR,    u.ambientColor,    last.ambientColor);
+    setVec4(UNIFORM_LIGHT_COLOR,      u.lightColor,      last.lightColor);
+
+    setMat3(UNIFORM_VIEW_ROTATION, u.viewRotation, last.viewRotation);
+    setMat3(UNIFORM_OBJ_ROTATION,  u.objRotation,  last.objRotation);
+
+    setInteger(UNIFORM_MAX_ITERATIONS, u.maxIterations, last.maxIterations);
+    setInteger(UNIFORM_STEP_LIMIT,     u.stepLimit,     last.stepLimit);
+    setFloat  (UNIFORM_EPSILON_SCALE,  u.epsilonScale,  last.epsilonScale);
+
+    setFloat(UNIFORM_AO_STEPS, u.aoSteps, last.aoSteps);
+
+    setFloat(UNIFORM_FOG_DISTANCE, u.fogDistance,  last.fogDistance);
+    setFloat(UNIFORM_RENDER_DEPTH, u.render_depth, last.render_depth);
+
+    setFloat(UNIFORM_GLOW_DEPTH, u.glowDepth, last.glowDepth);
+    setFloat(UNIFORM_GLOW_MULTI, u.glowMulti, last.glowMulti);
+
+    setInteger(UNIFORM_RAVE,        u.rave,       last.rave);
+    setFloat  (UNIFORM_PULSE,       u.pulse,      last.pulse);
+    setFloat  (UNIFORM_PULSE_SCALE, u.pulseScale, last.pulseScale);
+
+    setVec3(UNIFORM_GLOW_COLOUR, u.glowColour, last.glowColour);
+
+    setInteger(UNIFORM_BACKGROUND_GRADIENT, u.backgroundGradient, last.backgroundGradient);
+
+    setFloat(UNIFORM_FOV, u.fov, last.fov);
+
+    last     = u;
+    uploaded = true;
+
+    return upload_count;
+}
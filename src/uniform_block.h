@@ -0,0 +1,107 @@
+/*
+    Copyright (C) 2010 Andrew Caudwell (acaudwell@gmail.com)
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version
+    3 of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef MANDELBULB_UNIFORM_BLOCK_H
+#define MANDELBULB_UNIFORM_BLOCK_H
+
+#include "core/shader.h"
+
+#include "viewer_uniforms.h"
+
+enum {
+    UNIFORM_WIDTH,
+    UNIFORM_HEIGHT,
+    UNIFORM_CAMERA,
+    UNIFORM_CAMERA_FINE,
+    UNIFORM_CAMERA_ZOOM,
+    UNIFORM_JULIA,
+    UNIFORM_JULIA_C,
+    UNIFORM_RADIOLARIA,
+    UNIFORM_RADIOLARIA_FACTOR,
+    UNIFORM_POWER,
+    UNIFORM_INT_POWER,
+    UNIFORM_BOUNDING,
+    UNIFORM_BAILOUT,
+    UNIFORM_ANTIALIASING,
+    UNIFORM_PHONG,
+    UNIFORM_SHADOWS,
+    UNIFORM_AMBIENT_OCCLUSION,
+    UNIFORM_AMBIENT_OCCLUSION_EMPHASIS,
+    UNIFORM_COLOR_SPREAD,
+    UNIFORM_RIM_LIGHT,
+    UNIFORM_SPECULARITY,
+    UNIFORM_SPECULAR_EXPONENT,
+    UNIFORM_LIGHT,
+    UNIFORM_BACKGROUND_COLOR,
+    UNIFORM_DIFFUSE_COLOR,
+    UNIFORM_AMBIENT_COLOR,
+    UNIFORM_LIGHT_COLOR,
+    UNIFORM_VIEW_ROTATION,
+    UNIFORM_OBJ_ROTATION,
+    UNIFORM_MAX_ITERATIONS,
+    UNIFORM_STEP_LIMIT,
+    UNIFORM_EPSILON_SCALE,
+    UNIFORM_AO_STEPS,
+    UNIFORM_FOG_DISTANCE,
+    UNIFORM_RENDER_DEPTH,
+    UNIFORM_GLOW_DEPTH,
+    UNIFORM_GLOW_MULTI,
+    UNIFORM_RAVE,
+    UNIFORM_PULSE,
+    UNIFORM_PULSE_SCALE,
+    UNIFORM_GLOW_COLOUR,
+    UNIFORM_BACKGROUND_GRADIENT,
+    UNIFORM_FOV,
+    UNIFORM_COUNT
+};
+
+// The uniforms of one shader program with their locations resolved once
+// when it is created. upload() only sends the values that differ from
+// the ones last sent to this program.
+//
+// The shader is GLSL 1.10 so a uniform buffer object is not an option;
+// skipping unchanged values gets most of the benefit without it.
+
+class MandelbulbUniformBlock {
+    Shader* shader;
+
+    GLint locations[UNIFORM_COUNT];
+
+    MandelbulbUniforms last;
+    bool uploaded;
+
+    int upload_count;
+
+    void setFloat  (int id, float value, float previous);
+    void setInteger(int id, int value, int previous);
+    void setVec3   (int id, const vec3f& value, const vec3f& previous);
+    void setVec4   (int id, const vec4f& value, const vec4f& previous);
+    void setMat3   (int id, const mat3f& value, const mat3f& previous);
+public:
+    MandelbulbUniformBlock(Shader* shader);
+
+    Shader* getShader();
+
+    // upload changed values, the shader must be in use
+    // returns the number of uniforms that were sent
+    int upload(const MandelbulbUniforms& uniforms);
+
+    // force every value to be sent on the next upload
+    void invalidate();
+};
+
+#endif
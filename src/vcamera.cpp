@@ -27,6 +27,9 @@
 
 #include "vcamera.h"
 
+#include <algorithm>
+#include <cmath>
+
 Object3D::Object3D() {
     side    = vec3f(1.0, 0.0, 0.0);
     up      = vec3f(0.0, 1.0, 0.0);
@@ -117,14 +120,26 @@ void Object3D::rotateZ(float radians) {
     side.normalize();
 }
 
+quatf Object3D::getOrientation() {
+    return quatf::fromMatrix(getRotationMatrix());
+}
+
+void Object3D::setOrientation(const quatf& orientation) {
+
+    mat3f m = orientation.toMatrix();
+
+    //the matrix columns are -side, up and -forward
+    side    = vec3f(-m.matrix[0][0], -m.matrix[1][0], -m.matrix[2][0]);
+    up      = vec3f( m.matrix[0][1],  m.matrix[1][1],  m.matrix[2][1]);
+    forward = vec3f(-m.matrix[0][2], -m.matrix[1][2], -m.matrix[2][2]);
+}
+
 Object3D Object3D::interpolate(Object3D& obj, float dt) {
 
     Object3D result;
 
     result.setPos( pos + (obj.getPos() - pos) * dt );
-    result.setUp( up + (obj.getUp() - up) * dt );
-    result.setSide( side + (obj.getSide() - side) * dt );
-    result.setForward( forward + (obj.getForward() - forward) * dt );
+    result.setOrientation( quatf::slerp(getOrientation(), obj.getOrientation(), dt) );
 
     return result;
 }
@@ -150,9 +165,7 @@ ViewCamera ViewCamera::interpolate(ViewCamera& obj, float dt) {
     ViewCamera result;
 
     result.setPos( pos + (obj.getPos() - pos) * dt );
-    result.setUp( up + (obj.getUp() - up) * dt );
-    result.setSide( side + (obj.getSide() - side) * dt );
-    result.setForward( forward + (obj.getForward() - forward) * dt );
+    result.setOrientation( quatf::slerp(getOrientation(), obj.getOrientation(), dt) );
 
     return result;
 }
@@ -160,28 +173,25 @@ ViewCamera ViewCamera::interpolate(ViewCamera& obj, float dt) {
 // ViewCameraEvent
 
 ViewCameraEvent::ViewCameraEvent() {
-    finished=false;
-}
-
-bool ViewCameraEvent::isFinished() {
-    return finished;
+    duration = 0.0;
+    speed    = 0.0;
 }
 
 ViewCameraEvent::ViewCameraEvent(const ViewCamera& cam, float duration) {
-    this->start  = cam;
-    this->finish = cam;
+    this->camera   = cam;
     this->duration = duration;
-    elapsed = 0.0;
-    finished = false;
+    this->speed    = 0.0;
 }
 
-void ViewCameraEvent::prepare(ViewCameraEvent& prev) {
-    this->start = prev.getCamera();
-    finished=false;
-    elapsed = 0.0;
+float ViewCameraEvent::getSpeed() const {
+    return speed;
 }
 
-float ViewCameraEvent::getDuration() {
+void ViewCameraEvent::setSpeed(float speed) {
+    this->speed = speed;
+}
+
+float ViewCameraEvent::getDuration() const {
     return duration;
 }
 
@@ -189,23 +199,8 @@ void ViewCameraEvent::setDuration(float duration) {
     this->duration = duration;
 }
 
-ViewCamera ViewCameraEvent::getCamera() {
-    return finish;
-}
-
-void ViewCameraEvent::logic(float dt, ViewCamera* cam) {
-    elapsed += dt;
-
-    if(elapsed >= duration || duration <= 0.0f) {
-        *cam = finish;
-        elapsed = duration;
-        finished=true;
-        return;
-    }
-
-    float pc = elapsed/duration;
-
-    *cam = (ViewCamera) start.interpolate(finish, pc);
+ViewCamera ViewCameraEvent::getCamera() const {
+    return camera;
 }
 
 //ViewCameraPath
@@ -245,8 +240,12 @@ void ViewCameraPath::load(ConfFile& conf) {
         ViewCameraEvent* e =
             new ViewCameraEvent(cam, section->getFloat("duration"));
 
-        addEvent(e);
+        pushEvent(e);
     }
+
+    //build the spline once rather than after each camera
+    buildSpline();
+    updateEventTimes();
 }
 
 void ViewCameraPath::save(ConfFile& conf) {
@@ -276,7 +275,7 @@ bool ViewCameraPath::isFinished() {
 void ViewCameraPath::reset() {
     finished=false;
     current_index = -1;
-    current = 0;
+    time = 0.0;
 }
 
 void ViewCameraPath::clear() {
@@ -284,6 +283,8 @@ void ViewCameraPath::clear() {
         delete *it;
     }
     events.clear();
+    buildSpline();
+    updateEventTimes();
     reset();
 }
 
@@ -299,23 +300,184 @@ void ViewCameraPath::deleteLast() {
         ViewCameraEvent* last = events.back();
         events.pop_back();
         delete last;
+
+        spline.removeLast();
+
+        //the new last event has lost the neighbour its segment curved towards
+        updateEventTimes(events.size() > 0 ? events.size() - 1 : 0);
     }
 }
 
 
-void ViewCameraPath::addEvent(ViewCameraEvent* ce) {
+void ViewCameraPath::pushEvent(ViewCameraEvent* ce) {
 
+    //the duration is set from the length of the spline once it is known
     if(units_per_second>0.0 && events.size()>0) {
-        ViewCameraEvent* last = events[events.size()-1];
+        ce->setSpeed(units_per_second);
+    }
+
+    events.push_back(ce);
+}
+
+void ViewCameraPath::addEvent(ViewCameraEvent* ce) {
+
+    pushEvent(ce);
+
+    ViewCamera cam = ce->getCamera();
 
-        float dist = (ce->getCamera().getPos() - last->getCamera().getPos()).length();
+    spline.append(cam.getPos(), cam.getOrientation());
 
-        float duration = (1.0/units_per_second) * dist;
+    //only the last two segments change shape
+    updateEventTimes(events.size() > 2 ? events.size() - 2 : 0);
+}
+
+// how far a camera is from where it should be, the larger of the distance
+// (in units) and the angle it is turned by (in radians)
+
+static float cameraError(ViewCamera& cam, ViewCamera& target) {
+
+    //angle of the rotation between them (atan2 stays accurate when small)
+    quatf turn = cam.getOrientation().inverse() * target.getOrientation();
+    float angle = 2.0f * atan2f(sqrtf(turn.x*turn.x + turn.y*turn.y + turn.z*turn.z), fabsf(turn.w));
+
+    return std::max((cam.getPos() - target.getPos()).length(), angle);
+}
+
+// Ramer-Douglas-Peucker over the cameras, measured along the played path:
+// starting from the first and last camera, the path through the cameras
+// kept so far is played at the time of each camera left out, and between
+// each two kept cameras the one it passes furthest from is kept if that is
+// further than the tolerance. This repeats until the path passes within
+// the tolerance of every camera left out (as keeping a camera changes the
+// curve of the segments either side of it).
+//
+// The duration of a removed event is added to the next kept event so the
+// cameras still kept are reached at the same times, and the events play
+// for those durations rather than at a speed.
+
+int ViewCameraPath::simplify(float tolerance, ViewCameraPath& output) const {
+
+    output.clear();
+
+    int count = events.size();
+
+    std::vector<bool> keep(count, true);
+
+    if(count >= 3 && tolerance >= 0.0f) {
+
+        std::fill(keep.begin(), keep.end(), false);
+        keep[0] = keep[count-1] = true;
+
+        bool changed = true;
+
+        while(changed) {
+            changed = false;
+
+            ViewCameraPath trial;
+            keepEvents(keep, trial);
+
+            int furthest = -1;
+            float furthest_error = tolerance;
 
-        ce->setDuration(duration);
+            for(int i = 1; i < count; i++) {
+
+                if(keep[i]) {
+                    if(furthest != -1) {
+                        keep[furthest] = true;
+                        changed = true;
+                    }
+
+                    furthest = -1;
+                    furthest_error = tolerance;
+                    continue;
+                }
+
+                ViewCamera cam    = trial.evaluate(event_end[i]);
+                ViewCamera target = events[i]->getCamera();
+
+                float error = cameraError(cam, target);
+
+                if(error > furthest_error) {
+                    furthest_error = error;
+                    furthest = i;
+                }
+            }
+        }
     }
 
-    events.push_back(ce);
+    keepEvents(keep, output);
+
+    return count - output.size();
+}
+
+// copy the kept events to path, each lasting until the time its camera was reached
+
+void ViewCameraPath::keepEvents(const std::vector<bool>& keep, ViewCameraPath& path) const {
+
+    path.clear();
+
+    double last_end = 0.0;
+
+    for(size_t i = 0; i < events.size(); i++) {
+        if(!keep[i]) continue;
+
+        path.pushEvent(new ViewCameraEvent(events[i]->getCamera(), (float) (event_end[i] - last_end)));
+
+        last_end = event_end[i];
+    }
+
+    path.buildSpline();
+    path.updateEventTimes();
+}
+
+// rebuild the spline through all the cameras
+
+void ViewCameraPath::buildSpline() {
+
+    std::vector<vec3f> points;
+    std::vector<quatf> rotations;
+
+    for(size_t i = 0; i < events.size(); i++) {
+        ViewCamera cam = events[i]->getCamera();
+
+        points.push_back(cam.getPos());
+        rotations.push_back(cam.getOrientation());
+    }
+
+    spline.build(points, rotations);
+}
+
+// the running total of the event durations from event first on
+
+void ViewCameraPath::updateEventTimes(size_t first) {
+
+    //moving at a speed takes as long as the curve is long (which changes
+    //as the following camera is added)
+    for(size_t i = std::max((size_t) 1, first); i < events.size(); i++) {
+        float speed = events[i]->getSpeed();
+
+        if(speed > 0.0f) events[i]->setDuration(spline.getLength(i-1) / speed);
+    }
+
+    event_end.resize(events.size());
+
+    double end = first > 0 && first <= events.size() ? event_end[first-1] : 0.0;
+
+    for(size_t i = first; i < events.size(); i++) {
+        end += std::max(0.0f, events[i]->getDuration());
+        event_end[i] = end;
+    }
+}
+
+// the first event still playing at time t (the last if the path has ended)
+
+int ViewCameraPath::findEvent(double t) const {
+
+    if(events.empty()) return -1;
+
+    int index = std::upper_bound(event_end.begin(), event_end.end(), t) - event_end.begin();
+
+    return std::min(index, (int) events.size() - 1);
 }
 
 size_t ViewCameraPath::size() {
@@ -326,37 +488,96 @@ int ViewCameraPath::getIndex() {
     return current_index;
 }
 
-void ViewCameraPath::logic(float dt, ViewCamera* cam) {
-    if(finished) return;
+double ViewCameraPath::getDuration() const {
+    return event_end.empty() ? 0.0 : event_end.back();
+}
 
-    if(events.size() == 0) {
-        current = 0;
-        finished = true;
+// t within the path, wrapped around when looping
+
+double ViewCameraPath::pathTime(double t) const {
+
+    double duration = getDuration();
+
+    if(loop && duration > 0.0) {
+        t = fmod(t, duration);
+        if(t < 0.0) t += duration;
     }
 
-    if(current == 0) {
-        if(loop) {
-            current_index = (current_index + 1) % events.size();
-        } else {
-            current_index++;
+    return t;
+}
 
-            if(current_index >= events.size()) {
-                finished=true;
-                return;
-            }
-        }
+ViewCamera ViewCameraPath::evaluate(double t) const {
 
-        current = events[current_index];
+    if(events.empty()) return ViewCamera();
 
-        if(current_index>0) {
-            current->prepare(*events[current_index-1]);
-        }
+    t = pathTime(t);
+
+    int index = findEvent(t);
+
+    ViewCameraEvent* event = events[index];
+
+    double event_start = index > 0 ? event_end[index-1] : 0.0;
+
+    if(t >= event_end[index] || event->getDuration() <= 0.0f) {
+        return event->getCamera();
     }
 
-    current->logic(dt, cam);
+    //the first event holds its camera, the others move on from the one before
+    if(index == 0) return event->getCamera();
+
+    float pc = (float) ((std::max(t, event_start) - event_start) / event->getDuration());
+
+    vec3f pos;
+    quatf rotation;
 
-    if(current->isFinished()) {
-        current = 0;
+    spline.evaluate(index-1, pc, pos, rotation);
+
+    ViewCamera cam;
+    cam.setPos(pos);
+    cam.setOrientation(rotation);
+
+    return cam;
+}
+
+void ViewCameraPath::seek(double t) {
+    time     = std::max(0.0, t);
+    finished = false;
+}
+
+double ViewCameraPath::getTime() const {
+    return time;
+}
+
+int ViewCameraPath::countFrames(float dt) const {
+
+    if(loop || events.empty() || dt <= 0.0f) return 0;
+
+    double duration = getDuration();
+
+    //the same steps as logic()
+    double t = 0.0;
+    int frames = 0;
+
+    while(t <= duration) {
+        t += dt;
+        frames++;
     }
+
+    return frames;
 }
 
+void ViewCameraPath::logic(float dt, ViewCamera* cam) {
+    if(finished) return;
+
+    //stop once a frame past the end (showing the last camera) has been played
+    if(events.empty() || (!loop && time > getDuration())) {
+        finished = true;
+        return;
+    }
+
+    time += dt;
+
+    current_index = findEvent(pathTime(time));
+
+    *cam = evaluate(time);
+}
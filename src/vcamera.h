@@ -31,6 +31,8 @@
 #include "core/matrix.h"
 #include "core/conffile.h"
 
+#include "camera_spline.h"
+
 #include <vector>
 
 class Object3D {
@@ -56,6 +58,10 @@ public:
     void rotateY(float angle);
     void rotateZ(float angle);
 
+    // orientation of getRotationMatrix() as a quaternion
+    quatf getOrientation();
+    void setOrientation(const quatf& orientation);
+
     Object3D interpolate(Object3D& obj, float dt);
 
     mat3f getRotationMatrix();
@@ -70,31 +76,40 @@ public:
 
 };
 
+// a camera the path reaches after moving for duration seconds
+// from the camera of the previous event, or at a given speed
+
 class ViewCameraEvent {
 
     float duration;
-    float elapsed;
-
-    ViewCamera start;
-    ViewCamera finish;
+    float speed;
 
-    bool finished;
+    ViewCamera camera;
 public:
     ViewCameraEvent();
     ViewCameraEvent(const ViewCamera& cam, float duration = 0.0);
 
-    ViewCamera getCamera();
-    float getDuration();
+    ViewCamera getCamera() const;
+    float getDuration() const;
     void setDuration(float duration);
 
-    bool isFinished();
-
-    void prepare(ViewCameraEvent& prev);
-    void logic(float dt, ViewCamera* cam);
+    // units per second, the duration then follows from the length of the path
+    float getSpeed() const;
+    void setSpeed(float speed);
 };
 
+// The camera at any time along a list of events.
+//
+// The end time of each event is kept in a table of running totals, so
+// evaluate() finds the event playing at a time with a binary search and
+// interpolates within it, without stepping through the events before.
+// logic() plays the path by advancing a time through it.
+//
+// The cameras are joined by a CameraSpline and each event moves along
+// its segment at constant speed.
+
 class ViewCameraPath {
-    ViewCameraEvent* current;
+    double time;
     int current_index;
 
     bool loop;
@@ -103,6 +118,16 @@ class ViewCameraPath {
     float units_per_second;
 
     std::vector<ViewCameraEvent*> events;
+    std::vector<double> event_end;
+
+    CameraSpline spline;
+
+    void pushEvent(ViewCameraEvent* ce);
+    void keepEvents(const std::vector<bool>& keep, ViewCameraPath& path) const;
+    void buildSpline();
+    void updateEventTimes(size_t first = 0);
+    double pathTime(double t) const;
+    int findEvent(double t) const;
 public:
     ViewCameraPath(bool loop = false);
     ~ViewCameraPath();
@@ -120,10 +145,27 @@ public:
 
     void deleteLast();
     void addEvent(ViewCameraEvent* ce);
+
+    // copy the path to output without the cameras it passes within
+    // tolerance of anyway, returns the number left out
+    int simplify(float tolerance, ViewCameraPath& output) const;
     void clear();
     void reset();
     bool isFinished();
 
+    // length of the path in seconds
+    double getDuration() const;
+
+    // the camera t seconds along the path
+    ViewCamera evaluate(double t) const;
+
+    // continue playing from t seconds along the path
+    void seek(double t);
+    double getTime() const;
+
+    // number of logic() steps of dt before the path finishes
+    int countFrames(float dt) const;
+
     void logic(float dt, ViewCamera* cam);
 };
 
@@ -44,8 +44,66 @@ int main(int argc, char *argv[]) {
         SDLAppQuit(exception.what());
     }
 
+    //render on the CPU without a window
+    if(gViewerSettings.headless) {
+
+        if(!gViewerSettings.output_ppm_filename.size()) {
+            SDLAppQuit("headless mode requires --output-ppm-stream");
+        }
+
+        try {
+            MandelbulbHeadless headless(conf, gViewerSettings.display_width, gViewerSettings.display_height);
+            headless.run(gViewerSettings.output_ppm_filename, gViewerSettings.output_framerate);
+
+        } catch(PPMExporterException& exception) {
+
+            char errormsg[1024];
+            snprintf(errormsg, 1024, "could not write to '%s'", exception.what());
+
+            SDLAppQuit(errormsg);
+        }
+
+        return 0;
+    }
+
+    //simplify the camera path of a recording without opening a window
+    if(!gViewerSettings.compact_recording.empty()) {
+
+        ViewCameraPath campath;
+        campath.load(conf);
+
+        if(campath.size()==0) {
+            SDLAppQuit("no camera path to compact");
+        }
+
+        ViewCameraPath simplified;
+        int removed = campath.simplify(gViewerSettings.path_tolerance, simplified);
+
+        ConfFile output;
+        output.setFilename(gViewerSettings.compact_recording);
+
+        gViewerSettings.exportDisplaySettings(output);
+        gViewerSettings.exportViewerSettings(output);
+        simplified.save(output);
+
+        try {
+            output.save();
+        } catch(ConfFileException& exception) {
+            SDLAppQuit(exception.what());
+        }
+
+        printf("wrote %s: %d of %d waypoints (%d removed)\n",
+            output.getFilename().c_str(), (int) simplified.size(), (int) campath.size(), removed);
+
+        return 0;
+    }
+
     display.enableShaders(true);
 
+    if(gViewerSettings.shader_cache) {
+        shadermanager.setCacheDir(gSDLAppConfDir + std::string("shadercache") + gSDLAppPathSeparator);
+    }
+
     if(gViewerSettings.multisample) {
         display.multiSample(4);
     }
@@ -63,6 +121,17 @@ int main(int argc, char *argv[]) {
 
         if(gViewerSettings.output_ppm_filename.size()) {
             viewer->createVideo(gViewerSettings.output_ppm_filename, gViewerSettings.output_framerate);
+        } else if(gViewerSettings.output_y4m_filename.size()) {
+            viewer->createVideo(gViewerSettings.output_y4m_filename, gViewerSettings.output_framerate, true);
+        } else if(gViewerSettings.output_image_pattern.size()) {
+            viewer->createImageSequence(gViewerSettings.output_image_pattern, gViewerSettings.output_framerate);
+        }
+
+        if(gViewerSettings.poster_filename.size()) {
+            int poster_width  = gViewerSettings.poster_width  > 0 ? gViewerSettings.poster_width  : display.width  * 4;
+            int poster_height = gViewerSettings.poster_height > 0 ? gViewerSettings.poster_height : display.height * 4;
+
+            viewer->createPoster(gViewerSettings.poster_filename, poster_width, poster_height);
         }
 
         viewer->run();
@@ -96,28 +165,19 @@ int main(int argc, char *argv[]) {
     return 0;
 }
 
-MandelbulbViewer::MandelbulbViewer(ConfFile& conf) : SDLApp() {
+MandelbulbViewer::MandelbulbViewer(ConfFile& conf) : SDLApp(), gbuffer(GL_RGBA32F_ARB, 3, GL_NEAREST), accumulation(GL_RGBA16F_ARB, 1, GL_LINEAR) {
 
     debug = false;
 
     mousemove = false;
 
     shader = 0;
-    time_elapsed = 0;
+    uniform_block = 0;
+    uniform_uploads = 0;
     paused = false;
 
-    mandelbulb.setPos(vec3f(0.0, 0.0, 0.0));
-    mandelbulb.rotateX(90.0f * DEGREES_TO_RADIANS);
-
     view.setPos(vec3f(0.0, 0.0, 2.6));
 
-    beatCount     = 0;
-    beatTimer     = 0.0;
-    beatGlowDepth = 0.0;
-    beatGlowMulti = 0.0;
-
-    pulse = -1.0;
-
     play = false;
     record = false;
 
@@ -140,20 +200,72 @@ MandelbulbViewer::MandelbulbViewer(ConfFile& conf) : SDLApp() {
 
     take_screenshot  = false;
 
+    gbuffer_supported = false;
+    gbuffer_complete  = false;
+    gbuffer_mixed     = false;
+    gbuffer_flags     = 0;
+    relit_only        = false;
+
+    accumulated_samples = 0;
+    accumulation_mixed  = false;
+    accumulated_flags   = 0;
+
+    picture_final  = false;
+    frame_skipped  = false;
+    skipped_frames = 0;
+
+    marched_pixels = 0.0f;
+
     runtime = 0.0;
     frame_skip = 0;
     frame_count = 0;
     fixed_tick_rate = 0.0;
+    export_frame = 0;
 
     frameExporter = 0;
+    screenshotExporter = 0;
+
+    frame_time_log = 0;
+    log_frame      = 0;
+
+    scanline_log = 0;
+
+    if(gViewerSettings.scanline_log.size()) {
+        scanline_log = fopen(gViewerSettings.scanline_log.c_str(), "w");
+
+        tile_scheduler.setLog(scanline_log);
+    }
+
+    tile_scheduler.setTileSize(gViewerSettings.tile_size);
+    tile_scheduler.setOrder(gViewerSettings.tile_order);
+
+    if(gViewerSettings.frame_time_log.size()) {
+        frame_time_log = fopen(gViewerSettings.frame_time_log.c_str(), "w");
+
+        if(frame_time_log != 0) {
+            fprintf(frame_time_log, "# frame dt_ms update_ms events\n");
+        }
+    }
+
+    poster_width  = 0;
+    poster_height = 0;
     record_frame_skip  = 10.0;
     record_frame_delta = 0.0;
 
     message_timer = 0.0;
 
-    srand(time(0));
+    unsigned int seed = gViewerSettings.getSeed();
+
+    srand(seed);
+    animation.setSeed(seed);
 
-    randomizeJuliaSeed();
+    //a recording is played with the julia seed it was recorded with, and
+    //frames written out use the seed of the settings like --headless does
+    ConfSection* settings = conf.getSection("mandelbulb");
+
+    if(!gViewerSettings.exporting() && (settings == 0 || !settings->hasValue("julia_c"))) {
+        randomizeJuliaSeed();
+    }
 
     //ignore mouse motion until we have finished setting up
     SDL_EventState(SDL_MOUSEMOTION, SDL_IGNORE);
@@ -174,11 +286,27 @@ MandelbulbViewer::MandelbulbViewer(ConfFile& conf) : SDLApp() {
 }
 
 MandelbulbViewer::~MandelbulbViewer() {
-    if(shader != 0) delete shader;
-    if(frameExporter != 0) delete frameExporter;
+    for(std::map<int, MandelbulbUniformBlock*>::iterator it = shader_variants.begin(); it != shader_variants.end(); it++) {
+        shadermanager.release(it->second->getShader());
+        delete it->second;
+    }
+    if(frameExporter != 0) {
+        frameExporter->finish();
+        delete frameExporter;
+    }
+
+    if(screenshotExporter != 0) {
+        screenshotExporter->finish();
+        delete screenshotExporter;
+    }
+
+    if(frame_time_log != 0) fclose(frame_time_log);
+    if(scanline_log != 0)   fclose(scanline_log);
 }
 
-void MandelbulbViewer::createVideo(std::string filename, int video_framerate) {
+// set up playing the recording one output frame at a time
+
+void MandelbulbViewer::prepareExport(int video_framerate) {
     if(campath.size()==0) {
         SDLAppQuit("nothing to record");
     }
@@ -198,7 +326,221 @@ void MandelbulbViewer::createVideo(std::string filename, int video_framerate) {
 
     this->fixed_tick_rate = 1.0f / ((float) fixed_framerate);
 
-    this->frameExporter = new PPMExporter(filename);
+    //every exported frame is drawn in full, so frame N is the same whichever process renders it
+    setScanlineMode(false);
+
+    if(!gViewerSettings.resolveFrameRange(campath.countFrames(fixed_tick_rate * gViewerSettings.timescale))) {
+        SDLAppQuit("--frame-range and --shard need a recording that doesn't loop");
+    }
+}
+
+void MandelbulbViewer::createVideo(std::string filename, int video_framerate, bool y4m) {
+
+    prepareExport(video_framerate);
+
+    int threads = gViewerSettings.output_threads > 0 ? gViewerSettings.output_threads : 1;
+
+    if(y4m) {
+        //later parts of a split recording are appended to the first
+        bool header = gViewerSettings.frame_first == 1;
+
+        this->frameExporter = new Y4MExporter(filename, video_framerate, gViewerSettings.output_queue_depth, threads, header);
+    } else {
+        this->frameExporter = new PPMExporter(filename, gViewerSettings.output_queue_depth, threads);
+    }
+}
+
+void MandelbulbViewer::createImageSequence(std::string pattern, int video_framerate) {
+
+    prepareExport(video_framerate);
+
+    ImageFormat format = pattern.rfind(".qoi") == pattern.size() - 4 ? IMAGE_FORMAT_QOI : IMAGE_FORMAT_PNG;
+
+    int threads = gViewerSettings.output_threads > 0 ? gViewerSettings.output_threads : 4;
+
+    //keep every thread busy
+    int queue_depth = std::max(gViewerSettings.output_queue_depth, threads);
+
+    this->frameExporter = new ImageSequenceExporter(pattern, format, gViewerSettings.output_compression, queue_depth, threads, gViewerSettings.frame_first);
+}
+
+void MandelbulbViewer::createPoster(std::string filename, int width, int height) {
+    poster_filename = filename;
+    poster_width    = width;
+    poster_height   = height;
+}
+
+// Render the current view at poster_width x poster_height one tile at a time.
+// Each tile is drawn with the texture coordinates of its part of the full
+// image, and each completed strip of tiles is written straight to disk, so
+// only one strip is ever held in memory.
+
+void MandelbulbViewer::renderPoster() {
+
+    int tile_width  = std::min(POSTER_TILE_SIZE, poster_width);
+    int tile_height = std::min(POSTER_TILE_SIZE, poster_height);
+
+    ImageStreamWriter writer;
+
+    if(!writer.open(poster_filename, poster_width, poster_height, gViewerSettings.output_compression)) {
+        throw PPMExporterException(poster_filename);
+    }
+
+    RenderTarget tile;
+    tile.resize(tile_width, tile_height);
+
+    size_t strip_rowstride = poster_width * 3;
+
+    unsigned char* strip  = new unsigned char[strip_rowstride * tile_height];
+    unsigned char* pixels = new unsigned char[tile_width * tile_height * 3];
+
+    size_t buffer_memory = strip_rowstride * tile_height + tile_width * tile_height * 3;
+
+    int tiles_x = (poster_width  + tile_width  - 1) / tile_width;
+    int tiles_y = (poster_height + tile_height - 1) / tile_height;
+
+    printf("rendering %dx%d poster as %dx%d tiles of %dx%d\n",
+        poster_width, poster_height, tiles_x, tiles_y, tile_width, tile_height);
+
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glDisable(GL_BLEND);
+    glDisable(GL_TEXTURE_2D);
+
+    updateUniforms(poster_width, poster_height);
+    useShader();
+
+    Uint32 start_ticks = SDL_GetTicks();
+
+    bool written = true;
+
+    for(int ty = 0; ty < poster_height && written; ty += tile_height) {
+
+        int strip_height = std::min(tile_height, poster_height - ty);
+
+        for(int tx = 0; tx < poster_width; tx += tile_width) {
+
+            int w = std::min(tile_width, poster_width - tx);
+
+            tile.bind();
+
+            //the whole poster spans -1 to 1, top row first
+            float u0 = -1.0f + 2.0f * (float) tx / (float) poster_width;
+            float u1 = -1.0f + 2.0f * (float) (tx + tile_width) / (float) poster_width;
+            float v0 =  1.0f - 2.0f * (float) ty / (float) poster_height;
+            float v1 =  1.0f - 2.0f * (float) (ty + tile_height) / (float) poster_height;
+
+            glBegin(GL_QUADS);
+                glTexCoord2f(u1, v1);
+                glVertex2i(tile_width, tile_height);
+
+                glTexCoord2f(u0, v1);
+                glVertex2i(0, tile_height);
+
+                glTexCoord2f(u0, v0);
+                glVertex2i(0, 0);
+
+                glTexCoord2f(u1, v0);
+                glVertex2i(tile_width, 0);
+            glEnd();
+
+            //the top rows of the target hold the used part of an edge tile
+            glReadPixels(0, tile_height - strip_height, w, strip_height, GL_RGB, GL_UNSIGNED_BYTE, pixels);
+
+            for(int y = 0; y < strip_height; y++) {
+                memcpy(strip + y * strip_rowstride + tx * 3, pixels + (strip_height - y - 1) * w * 3, w * 3);
+            }
+        }
+
+        for(int y = 0; y < strip_height && written; y++) {
+            written = writer.writeRow(strip + y * strip_rowstride);
+        }
+
+        float elapsed = (float) (SDL_GetTicks() - start_ticks) / 1000.0f;
+        int tiles_done = (ty / tile_height + 1) * tiles_x;
+
+        printf("\r%d / %d tiles (%.2f tiles/s)", tiles_done, tiles_x * tiles_y, elapsed > 0.0f ? tiles_done / elapsed : 0.0f);
+        fflush(stdout);
+    }
+
+    printf("\n");
+
+    glUseProgramObjectARB(0);
+
+    RenderTarget::unbind();
+
+    delete[] strip;
+    delete[] pixels;
+
+    if(!writer.close() || !written) {
+        throw PPMExporterException(poster_filename);
+    }
+
+    float elapsed = (float) (SDL_GetTicks() - start_ticks) / 1000.0f;
+
+    printf("wrote %s in %.2f s (%.2f tiles/s)\n", poster_filename.c_str(), elapsed, elapsed > 0.0f ? (tiles_x * tiles_y) / elapsed : 0.0f);
+
+    printf("peak memory: %.1f MB of tile buffers", (float) buffer_memory / (1024.0f * 1024.0f));
+
+#ifndef _WIN32
+    struct rusage usage;
+
+    if(getrusage(RUSAGE_SELF, &usage) == 0) {
+#ifdef __APPLE__
+        printf(", %.1f MB resident", (float) usage.ru_maxrss / (1024.0f * 1024.0f));
+#else
+        printf(", %.1f MB resident", (float) usage.ru_maxrss / 1024.0f);
+#endif
+    }
+#endif
+
+    printf("\n");
+}
+
+int MandelbulbViewer::getShaderFlags() {
+    int flags = 0;
+
+    if(uniforms.julia)                              flags |= SHADER_JULIA;
+    if(uniforms.phong)                              flags |= SHADER_PHONG;
+    if(uniforms.radiolaria)                         flags |= SHADER_RADIOLARIA;
+    if(uniforms.phong && uniforms.shadows > 0.0f)   flags |= SHADER_SHADOWS;
+    if(uniforms.pulse >= 0.0f)                      flags |= SHADER_PULSE;
+    if(uniforms.rave)                               flags |= SHADER_RAVE;
+    if(uniforms.backgroundGradient)                 flags |= SHADER_BACKGROUND_GRADIENT;
+    if(uniforms.antialiasing > 0)                   flags |= SHADER_ANTIALIASING;
+    if(uniforms.intPower > 0)                       flags |= SHADER_INTEGER_POWER;
+
+    return flags;
+}
+
+//the shader compiled for the current combination of features
+MandelbulbUniformBlock* MandelbulbViewer::getShaderVariant(int pass_flags) {
+
+    int flags = getShaderFlags() | pass_flags;
+
+    //one sample per frame replaces supersampling
+    if(flags & SHADER_PROGRESSIVE) flags &= ~SHADER_ANTIALIASING;
+
+    std::map<int, MandelbulbUniformBlock*>::iterator it = shader_variants.find(flags);
+
+    if(it != shader_variants.end()) return it->second;
+
+    static const char* flag_names[] = {
+        "JULIA", "PHONG", "RADIOLARIA", "SHADOWS", "PULSE",
+        "RAVE", "BACKGROUND_GRADIENT", "ANTIALIASING", "INTEGER_POWER",
+        "GBUFFER_PASS", "LIGHTING_PASS", "PROGRESSIVE"
+    };
+
+    std::string defines;
+
+    for(int i = 0; i < (int) (sizeof(flag_names) / sizeof(const char*)); i++) {
+        if(flags & (1 << i)) defines += std::string("#define ") + flag_names[i] + "\n";
+    }
+
+    MandelbulbUniformBlock* variant = new MandelbulbUniformBlock(shadermanager.grab(gViewerSettings.shader, defines));
+
+    shader_variants[flags] = variant;
+
+    return variant;
 }
 
 void MandelbulbViewer::randomizeJuliaSeed() {
@@ -216,10 +558,25 @@ void MandelbulbViewer::randomizeColours() {
 void MandelbulbViewer::init() {
     display.setClearColour(vec3f(0.0, 0.0, 0.0));
 
-    shader = shadermanager.grab(gViewerSettings.shader);
+    //compile the variant for the starting settings up front
+    animation.update(gViewerSettings, uniforms);
+
+    uniform_block = getShaderVariant();
+    shader        = uniform_block->getShader();
+
+    if(!RenderTarget::supported()) {
+        throw SDLAppException("video card does not support framebuffer objects");
+    }
+
+    progress_target = &render_targets[0];
+    frame_target    = &render_targets[1];
 
-    rendertex = display.emptyTexture(display.width, display.height, GL_RGBA);
-    frametex  = display.emptyTexture(display.width, display.height, GL_RGBA);
+    //without float targets every frame is marched and shaded in one pass
+    gbuffer_supported = RenderTarget::floatSupported();
+
+    if(!gbuffer_supported) {
+        debugLog("float render targets not supported, deferred shading and progressive rendering disabled\n");
+    }
 
     font = fontmanager.grab("FreeSans.ttf", 16);
     font.dropShadow(true);
@@ -229,7 +586,7 @@ void MandelbulbViewer::init() {
 }
 
 void MandelbulbViewer::setScanlineMode(bool scanline_mode) {
-    scanline_count      = 0;
+    tile_scheduler.restart();
     scanline_batch_size = 0;
     this->scanline_mode = scanline_mode;
     if(!scanline_mode) scanline_debug = false;
@@ -422,9 +779,14 @@ void MandelbulbViewer::saveRecording() {
 
     conf.setFilename(recname);
 
+    //drop the cameras the path passes close enough to anyway (from a copy,
+    //so saving again after recording more doesn't simplify twice)
+    ViewCameraPath simplified;
+    campath.simplify(gViewerSettings.path_tolerance, simplified);
+
     gViewerSettings.exportDisplaySettings(conf);
     gViewerSettings.exportViewerSettings(conf);
-    campath.save(conf);
+    simplified.save(conf);
 
     try {
         conf.save();
@@ -432,54 +794,27 @@ void MandelbulbViewer::saveRecording() {
         SDLAppQuit(exception.what());
     }
 
-    setMessage("Wrote " + conf.getFilename());
+    char msgbuff[256];
+    snprintf(msgbuff, 256, "Wrote %s (%d of %d waypoints)", conf.getFilename().c_str(), (int) simplified.size(), (int) campath.size());
+
+    setMessage(msgbuff);
 }
 
 void MandelbulbViewer::screenshot() {
 
-    char* screenbuff = new char[display.width * display.height * 4];
-
-    glReadPixels(0, 0, display.width, display.height,
-                 GL_BGRA, GL_UNSIGNED_BYTE, screenbuff);
-
-    const char tga_header[12] = { 0, 0, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0 };
-    short width           = display.width;
-    short height          = display.height;
-    char  bitsperpixel    = 32;
-    char  imagedescriptor = 8;
-
-    //get next free recording name
-    char tganame[256];
-    struct stat finfo;
-    int tgano = 1;
-
-    while(tgano < 10000) {
-        snprintf(tganame, 256, "screenshot-%04d.tga", tgano);
-        if(stat(tganame, &finfo) != 0) break;
-        tgano++;
+    //read back and write out in the background
+    if(screenshotExporter == 0) {
+        screenshotExporter = new ScreenshotExporter();
     }
 
-    //write tga
-    std::string filename(tganame);
-
+    std::string filename = screenshotExporter->screenshot();
 
-    std::ofstream tga;
-    tga.open(filename.c_str(), std::ios::out | std::ios::binary );
-
-    if(!tga.is_open()) return;
-
-    tga.write(tga_header, 12);
-    tga.write((char*)&width, sizeof(short));
-    tga.write((char*)&height, sizeof(short));
-    tga.write(&bitsperpixel, 1);
-    tga.write(&imagedescriptor, 1);
-
-    tga.write(screenbuff, display.width * display.height * 4);
-    tga.close();
-
-    delete[] screenbuff;
+    if(filename.empty()) {
+        setMessage("No free screenshot name", vec3f(1.0, 0.0, 0.0));
+        return;
+    }
 
-    setMessage("Wrote screenshot " + std::string(tganame));
+    setMessage("Wrote screenshot " + filename);
 }
 
 void MandelbulbViewer::resetCamPath() {
@@ -696,18 +1031,107 @@ void MandelbulbViewer::drawAlignedQuad(int w, int h) {
     glPopMatrix();
 }
 
+// the tiles of the current batch, or the whole frame when not drawing tiles
+
+void MandelbulbViewer::drawRegion(int w, int h) {
+
+    if(batch_tiles.empty()) {
+        drawAlignedQuad(w, h);
+        return;
+    }
+
+    //texture coordinates run from -1,1 at the origin to 1,-1 at w,h as in drawAlignedQuad
+    glBegin(GL_QUADS);
+
+    for(size_t i = 0; i < batch_tiles.size(); i++) {
+        const RenderTile& tile = batch_tiles[i];
+
+        float x0 = -1.0f + 2.0f * tile.x / w;
+        float x1 = -1.0f + 2.0f * (tile.x + tile.w) / w;
+        float y0 = 1.0f - 2.0f * tile.y / h;
+        float y1 = 1.0f - 2.0f * (tile.y + tile.h) / h;
+
+        glTexCoord2f(x1, y1);
+        glVertex2i(tile.x + tile.w, tile.y + tile.h);
+
+        glTexCoord2f(x0, y1);
+        glVertex2i(tile.x, tile.y + tile.h);
+
+        glTexCoord2f(x0, y0);
+        glVertex2i(tile.x, tile.y);
+
+        glTexCoord2f(x1, y0);
+        glVertex2i(tile.x + tile.w, tile.y);
+    }
+
+    glEnd();
+}
+
+// outline tiles of a w x h frame scaled up to the display
+
+void MandelbulbViewer::drawTileOutlines(const std::vector<RenderTile>& tiles, int w, int h) {
+
+    if(w <= 0 || h <= 0) return;
+
+    float sx = (float) display.width  / w;
+    float sy = (float) display.height / h;
+
+    glDisable(GL_TEXTURE_2D);
+
+    for(size_t i = 0; i < tiles.size(); i++) {
+        const RenderTile& tile = tiles[i];
+
+        glBegin(GL_LINE_LOOP);
+            glVertex2f(tile.x * sx + 0.5f,            tile.y * sy + 0.5f);
+            glVertex2f((tile.x + tile.w) * sx - 0.5f, tile.y * sy + 0.5f);
+            glVertex2f((tile.x + tile.w) * sx - 0.5f, (tile.y + tile.h) * sy - 0.5f);
+            glVertex2f(tile.x * sx + 0.5f,            (tile.y + tile.h) * sy - 0.5f);
+        glEnd();
+    }
+}
+
 void MandelbulbViewer::update(float t, float dt) {
     //dt = std::max(dt, 1.0f/25.0f);
 
+    Uint32 update_start = SDL_GetTicks();
+    float frame_dt      = dt;
+    bool screenshot_requested = take_screenshot;
+
     //if exporting a video use a fixed tick rate rather than time based
     if(frameExporter != 0) dt = fixed_tick_rate;
     dt *= gViewerSettings.timescale;
 
+    if(frameExporter != 0) {
+        //frames before the range only advance the state
+        while(export_frame + 1 < gViewerSettings.frame_first && !appFinished) {
+            runtime += dt;
+            logic(runtime, dt);
+            export_frame++;
+        }
+
+        export_frame++;
+
+        if(appFinished || (gViewerSettings.frame_last > 0 && export_frame > gViewerSettings.frame_last)) {
+            appFinished = true;
+            return;
+        }
+    }
+
     runtime += dt;
 
     logic(runtime, dt);
+
+    if(poster_filename.size()) {
+        renderPoster();
+        appFinished = true;
+        return;
+    }
+
     draw(runtime, dt);
 
+    //without timer queries the best guess at the cost is the whole frame
+    if(!GPUTimer::supported()) resolution.addMeasurement(frame_dt * 1000.0f, marched_pixels);
+
     //extract frames based on frameskip setting
     //if frameExporter defined
     if(frameExporter != 0) {
@@ -716,20 +1140,92 @@ void MandelbulbViewer::update(float t, float dt) {
         }
     }
 
-    if(!scanline_mode || scanline_count >= render_height) {
-        if(scanline_mode) scanline_count = 0;
+    if(!scanline_mode || tile_scheduler.finished()) {
+        if(scanline_mode) tile_scheduler.restart();
         frame_count++;
     }
 
+    //pass finished screenshot read backs to the writer thread
+    if(screenshotExporter != 0) screenshotExporter->poll();
+
     cursor.logic(dt);
     cursor.draw();
+
+    if(frame_time_log != 0) {
+        fprintf(frame_time_log, "%d %.3f %u%s%s\n", log_frame++, frame_dt * 1000.0f, SDL_GetTicks() - update_start,
+            screenshot_requested ? " screenshot" : "", frame_skipped ? " skipped" : "");
+    }
+}
+
+// nothing will change until there is input, so SDLApp::run can wait for it
+
+bool MandelbulbViewer::isIdle() {
+
+    //frames still have to be produced or written
+    if(play || record || frameExporter != 0 || poster_filename.size() || take_screenshot) return false;
+
+    if(screenshotExporter != 0 && screenshotExporter->getPendingFrames() > 0) return false;
+
+    //animated parameters
+    if(!paused) {
+        if(gViewerSettings.animated || gViewerSettings.beat > 0.0f || gViewerSettings.pulsate) return false;
+
+        vec3f rotation = gViewerSettings.rotation;
+
+        if(rotation.x != 0.0f || rotation.y != 0.0f || rotation.z != 0.0f) return false;
+    }
+
+    //fading out
+    if(message_timer > 0.0f || cursor.isVisible()) return false;
+
+    //still has to go back to full resolution
+    if(getRenderScale() < 1.0f) return false;
+
+    return picture_final;
+}
+
+// exported frames are always drawn at full resolution
+
+float MandelbulbViewer::getRenderScale() {
+    return frameExporter != 0 ? 1.0f : resolution.getScale();
+}
+
+// pick the render scale for the next frame from the latest timings
+
+void MandelbulbViewer::updateResolution(float dt) {
+
+    float ms, pixels;
+
+    while(march_timer.getResult(ms, pixels)) {
+        resolution.addMeasurement(ms, pixels);
+        tile_scheduler.addMeasurement(ms);
+    }
+
+    vec3f campos        = view.getPos();
+    mat3f view_rotation = view.getRotationMatrix();
+    mat3f obj_rotation  = animation.mandelbulb.getRotationMatrix();
+
+    bool moving = memcmp(&campos, &last_campos, sizeof(vec3f))
+               || memcmp(&view_rotation, &last_view_rotation, sizeof(mat3f))
+               || memcmp(&obj_rotation, &last_obj_rotation, sizeof(mat3f));
+
+    last_campos        = campos;
+    last_view_rotation = view_rotation;
+    last_obj_rotation  = obj_rotation;
+
+    float full_width  = display.width  * gViewerSettings.viewscale;
+    float full_height = display.height * gViewerSettings.viewscale;
+
+    resolution.setTargetFPS(scanline_target_fps);
+    resolution.update(dt, moving, full_width * full_height);
 }
 
 void MandelbulbViewer::logic(float t, float dt) {
 
-    if(scanline_mode && scanline_count > 0) {
+    if(scanline_mode && tile_scheduler.started()) {
         //drawing previous frame
         moveCam(dt);
+        updateResolution(dt);
         return;
     }
 
@@ -746,14 +1242,11 @@ void MandelbulbViewer::logic(float t, float dt) {
         moveCam(dt);
     }
 
-    //set render width/height
-    render_width  = display.width * gViewerSettings.viewscale;
-    render_height = display.height * gViewerSettings.viewscale;
+    updateResolution(dt);
 
-    if(mouselook) {
-        render_width  *= 0.25;
-        render_height *= 0.25;
-    }
+    //set render width/height
+    render_width  = display.width * gViewerSettings.viewscale * getRenderScale();
+    render_height = display.height * gViewerSettings.viewscale * getRenderScale();
 
     //roll doesnt make any sense unless mouselook is enabled
     if(!mouselook) {
@@ -776,303 +1269,381 @@ void MandelbulbViewer::logic(float t, float dt) {
 
     if(paused) return;
 
-    time_elapsed += dt;
+    animation.logic(gViewerSettings, dt, view.getPos());
 
-    //update beat
-    if(gViewerSettings.beat>0.0) {
-        beatTimer += dt;
+    frame_count++;
 
-        if(beatTimer>gViewerSettings.beat*2.0) {
-            beatTimer=0.0;
-            beatCount++;
+    if(play) {
+        vec3f green(0.0, 1.0, 0.0);
 
-            if(gViewerSettings.beatPeriod>0 && beatCount % gViewerSettings.beatPeriod == 0) {
-                gViewerSettings.glowColour = vec3f(rand() % 100, rand() % 100, rand() % 100).normal();
-            }
-        }
+        char msgbuff[256];
+        snprintf(msgbuff, 256, "Playing %d / %d", campath.getIndex(), campath.size());
+        setMessage(std::string(msgbuff), green);
+    }
 
-        pulse = beatTimer/gViewerSettings.beat;
+    if(message_timer>0.0) message_timer -= dt;
+}
 
-        if(pulse>1.0) pulse = 2.0-pulse;
 
-        beatGlowDepth = gViewerSettings.glowDepth * 0.5 + 0.5 * gViewerSettings.glowDepth * pulse;
-        beatGlowMulti = gViewerSettings.glowMulti * 0.5 + 0.5 * gViewerSettings.glowMulti * pulse;
-    }
+// set the uniforms for an image of the given size
 
-    //update julia seed
-    _julia_c = gViewerSettings.julia_c;
+void MandelbulbViewer::updateUniforms(int width, int height) {
 
-    if(gViewerSettings.animated) {
-        _julia_c = gViewerSettings.julia_c + vec3f(sinf(time_elapsed), sinf(time_elapsed), atan(time_elapsed)) * 0.1;
-    }
+    animation.update(gViewerSettings, uniforms);
 
-    //to avoid a visible sphere we need to set the bounding
-    //sphere to be greater than the camera's distance from the
-    //origin
-    if(gViewerSettings.backgroundGradient) {
-        gViewerSettings.bounding = std::max(gViewerSettings.bounding, view.getPos().length2());
-    }
+    uniforms.width  = width;
+    uniforms.height = height;
 
-    mandelbulb.rotateX(gViewerSettings.rotation.x * dt * DEGREES_TO_RADIANS);
-    mandelbulb.rotateY(gViewerSettings.rotation.y * dt * DEGREES_TO_RADIANS);
-    mandelbulb.rotateZ(gViewerSettings.rotation.z * dt * DEGREES_TO_RADIANS);
+    uniforms.camera       = view.getPos();
+    uniforms.viewRotation = viewRotation;
 
-    frame_count++;
+    uniforms.render_depth = render_depth;
+}
 
-    if(play) {
-        vec3f green(0.0, 1.0, 0.0);
+// enable the shader variant matching the uniforms and upload them
 
-        char msgbuff[256];
-        snprintf(msgbuff, 256, "Playing %d / %d", campath.getIndex(), campath.size());
-        setMessage(std::string(msgbuff), green);
-    }
+void MandelbulbViewer::useShader(int pass_flags) {
 
-    if(message_timer>0.0) message_timer -= dt;
+    uniform_block = getShaderVariant(pass_flags);
+
+    shader = uniform_block->getShader();
+    shader->use();
+
+    uniform_uploads = uniform_block->upload(uniforms);
 }
 
+// true if the G-buffer holds the whole surface for the current uniforms,
+// ie at most the colours changed since it was marched
 
-void MandelbulbViewer::drawMandelbulb(float dt) {
+bool MandelbulbViewer::gbufferCurrent(int flags) {
 
-    vec3f campos = view.getPos();
+    if(gbuffer.resize(render_width, render_height)) gbuffer_complete = false;
 
-    display.mode2D();
+    //a tiled frame starting over
+    if(!tile_scheduler.started()) gbuffer_mixed = false;
 
-    //draw partially drawn image
-    if(scanline_mode) {
+    if(!gbuffer_complete || flags != gbuffer_flags || !uniforms.sameGeometry(gbuffer_uniforms)) {
 
-        //on initial frame capture the background colour onto the render tex / frame tex
-        if(frame_count == 0 && scanline_count == 0) {
-            glEnable(GL_TEXTURE_2D);
+        //the camera moved part way through the tiles
+        if(tile_scheduler.started()) gbuffer_mixed = true;
 
-            glBindTexture(GL_TEXTURE_2D, rendertex);
-            glCopyTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 0, 0, render_width, render_height, 0);
+        gbuffer_complete = false;
+        gbuffer_flags    = flags;
+        gbuffer_uniforms = uniforms;
+    }
 
-            glBindTexture(GL_TEXTURE_2D, frametex);
-            glCopyTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 0, 0, display.width, display.height, 0);
-        }
+    return gbuffer_complete;
+}
 
-        //draw partial frame
-        if(scanline_count > 0) {
+// march into the G-buffer unless only relighting, then shade it into
+// the bound target (or the window)
 
-            glEnable(GL_TEXTURE_2D);
-            glDisable(GL_BLEND);
+void MandelbulbViewer::drawDeferred(bool relight) {
 
-            glBindTexture(GL_TEXTURE_2D, rendertex);
+    if(!relight) {
+        bool use_targets = scanline_mode || display.width != render_width || display.height != render_height;
 
-            glBegin(GL_QUADS);
-                glTexCoord2i(1,0);
-                glVertex2i(render_width, render_height);
+        gbuffer.bind();
 
-                glTexCoord2i(0,0);
-                glVertex2i(0, render_height);
+        useShader(SHADER_GBUFFER_PASS);
+        drawRegion(render_width, render_height);
 
-                glTexCoord2i(0,1);
-                glVertex2i(0,0);
+        if(use_targets) progress_target->bind();
+        else            RenderTarget::unbind();
 
-                glTexCoord2i(1,1);
-                glVertex2i(render_width,0);
-            glEnd();
+        //keep the marched surface if every tile of it was done with the same uniforms
+        if(!scanline_mode || (tile_scheduler.finished() && !gbuffer_mixed)) {
+            gbuffer_complete = true;
         }
     }
 
+    gbuffer.bindTextures();
 
-    //enable shader
-    shader->use();
+    useShader(SHADER_LIGHTING_PASS);
 
-    //configure shader
-    shader->setFloat("width",  render_width);
-    shader->setFloat("height", render_height);
+    shader->setInteger("gbuffer0", 0);
+    shader->setInteger("gbuffer1", 1);
+    shader->setInteger("gbuffer2", 2);
 
-    shader->setVec3("camera",         campos);
-    shader->setVec3("cameraFine",     vec3f(0.0f, 0.0f, 0.0f));
-    shader->setFloat("cameraZoom",    gViewerSettings.cameraZoom);
+    drawRegion(render_width, render_height);
+}
 
-    shader->setInteger("julia", gViewerSettings.juliaset);
-    shader->setVec3("julia_c",  _julia_c);
+// offset within the pixel of a progressive sample, the first is centred
 
-    shader->setInteger("radiolaria", gViewerSettings.radiolaria);
-    shader->setFloat("radiolariaFactor", gViewerSettings.radiolariaFactor);
+static vec2f progressiveJitter(int sample) {
 
-    shader->setFloat("power", gViewerSettings.power);
+    if(sample == 0) return vec2f(0.0f, 0.0f);
 
-    shader->setFloat("bounding", gViewerSettings.bounding );
-    shader->setFloat("bailout",  gViewerSettings.bailout );
+    //halton sequence (bases 2 and 3) spreads the samples evenly
+    float x = 0.0f, y = 0.0f;
+    float f;
 
-    shader->setInteger("antialiasing", gViewerSettings.antialiasing);
+    f = 0.5f;
+    for(int i = sample; i > 0; i /= 2, f *= 0.5f) x += f * (i % 2);
 
-    shader->setInteger("phong", gViewerSettings.phong);
-    shader->setFloat("shadows", gViewerSettings.shadows);
+    f = 1.0f / 3.0f;
+    for(int i = sample; i > 0; i /= 3, f /= 3.0f) y += f * (i % 3);
 
-    shader->setFloat("ambientOcclusion", gViewerSettings.ambientOcclusion);
-    shader->setFloat("ambientOcclusionEmphasis", gViewerSettings.ambientOcclusionEmphasis);
+    return vec2f(x - 0.5f, y - 0.5f);
+}
 
-    shader->setFloat("colorSpread",      gViewerSettings.colorSpread);
-    shader->setFloat("rimLight",         gViewerSettings.rimLight);
-    shader->setFloat("specularity",      gViewerSettings.specularity);
-    shader->setFloat("specularExponent", gViewerSettings.specularExponent);
+// average frames while nothing changes, except when the frames
+// have to match the uniforms exactly (eg when exporting them)
 
-    shader->setVec3("light", gViewerSettings.light);
+bool MandelbulbViewer::progressiveEnabled() {
+    return gbuffer_supported && gViewerSettings.progressive_samples > 0 && frameExporter == 0;
+}
 
-    shader->setVec4("backgroundColor", gViewerSettings.backgroundColor);
-    shader->setVec4("diffuseColor",    gViewerSettings.diffuseColor);
-    shader->setVec4("ambientColor",    gViewerSettings.ambientColor);
-    shader->setVec4("lightColor",      gViewerSettings.lightColor);
+// count the finished frames of the same picture (the samples of the
+// average when progressive), starting over if it changed
 
-    shader->setMat3("viewRotation", viewRotation);
-    shader->setMat3("objRotation",  mandelbulb.getRotationMatrix());
+void MandelbulbViewer::updateAccumulation(int flags) {
 
-    shader->setInteger("maxIterations", gViewerSettings.maxIterations);
-    shader->setInteger("stepLimit",     gViewerSettings.stepLimit);
-    shader->setFloat("epsilonScale",    gViewerSettings.epsilonScale);
+    if(progressiveEnabled() && accumulation.resize(render_width, render_height)) accumulated_samples = 0;
 
-    shader->setFloat("aoSteps", gViewerSettings.aoSteps);
+    //a tiled frame starting over
+    if(!tile_scheduler.started()) accumulation_mixed = false;
 
-    shader->setFloat("fogDistance", gViewerSettings.fogDistance);
-    shader->setFloat("render_depth", render_depth);
+    if(flags != accumulated_flags || !uniforms.sameImage(accumulated_uniforms)) {
 
-    if(gViewerSettings.beat>0.0) {
-        shader->setFloat("glowDepth", beatGlowDepth);
-        shader->setFloat("glowMulti", beatGlowMulti);
-    } else {
-        shader->setFloat("glowDepth", gViewerSettings.glowDepth);
-        shader->setFloat("glowMulti", gViewerSettings.glowMulti);
+        //the frame being drawn started with different uniforms
+        if(tile_scheduler.started()) accumulation_mixed = true;
+
+        accumulated_samples  = 0;
+        accumulated_flags    = flags;
+        accumulated_uniforms = uniforms;
     }
+}
+
+// count the finished frame and blend it into the average
 
-    shader->setInteger("Rave", gViewerSettings.rave);
-    shader->setFloat("Pulse", gViewerSettings.pulsate ? pulse : -1.0f);
-    shader->setFloat("PulseScale", gViewerSettings.pulseScale);
+void MandelbulbViewer::accumulateFrame() {
 
-    shader->setVec3("glowColour", gViewerSettings.glowColour);
+    if(accumulation_mixed) return;
 
+    if(!progressiveEnabled()) {
+        accumulated_samples++;
+        return;
+    }
 
-    shader->setInteger("backgroundGradient", gViewerSettings.backgroundGradient);
+    accumulation.bind();
 
-    if(!gViewerSettings.pulsateFov) {
-        shader->setFloat("fov", gViewerSettings.fov);
+    if(accumulated_samples == 0) {
+        glDisable(GL_BLEND);
     } else {
-        float pulse_fov = gViewerSettings.fov * sinf(pulse*0.5+0.5) * gViewerSettings.pulseFovScale;
+        //running mean: new sample weighted 1/n
+        glEnable(GL_BLEND);
+        glBlendColor(0.0f, 0.0f, 0.0f, 1.0f / (float) (accumulated_samples + 1));
+        glBlendFunc(GL_CONSTANT_ALPHA, GL_ONE_MINUS_CONSTANT_ALPHA);
+    }
+
+    glColor4f(1.0f, 1.0f, 1.0f, 1.0f);
+
+    frame_target->draw(render_width, render_height);
+
+    glDisable(GL_BLEND);
+
+    RenderTarget::unbind();
 
-        shader->setFloat("fov", pulse_fov);
+    accumulated_samples++;
+}
+
+void MandelbulbViewer::drawMandelbulb(float dt) {
+
+    bool resize_frame = display.width != render_width || display.height != render_height;
+
+    bool progressive = progressiveEnabled();
+
+    //render into the in-progress target instead of the window
+    bool use_targets = scanline_mode || resize_frame || progressive;
+
+    if(use_targets) {
+
+        //reallocate both targets when the render size changes
+        if(progress_target->resize(render_width, render_height) | frame_target->resize(render_width, render_height)) {
+            tile_scheduler.restart();
+        }
+
+        progress_target->bind();
+    } else {
+        display.mode2D();
     }
 
-    //set clipping area to area of scanline_batch_size
-    if(scanline_mode) {
+    updateUniforms(render_width, render_height);
 
-        //TODO: calculate based on previous value + dt ?
+    int flags = getShaderFlags();
 
-        if(scanline_batch_size == 0) {
+    updateAccumulation(flags);
 
-            scanline_batch_size = 1;
+    //after the first sample each frame is offset within the pixel
+    bool jittered = progressive && accumulated_samples > 0;
 
-        } else {
-            //adjust the number of scanlines to render
-            //based on whether or not we are meeting our rps/fps targets
+    int samples_needed = progressive ? gViewerSettings.progressive_samples : 1;
+
+    //the last finished frame (or average) is already the final picture
+    bool converged = use_targets && accumulated_samples >= samples_needed;
+
+    frame_skipped = converged;
+    if(frame_skipped) skipped_frames++;
+
+    //supersampling needs the full march for every sample
+    bool deferred = gbuffer_supported && !(flags & SHADER_ANTIALIASING) && !jittered;
+
+    relit_only = !converged && deferred && gbufferCurrent(flags);
+
+    float budget_ms = 1000.0f / scanline_target_fps;
+
+    if(scanline_mode) tile_scheduler.build(render_width, render_height, budget_ms);
+
+    //shading alone is cheap, so the whole frame is done at once
+    if((relit_only || converged) && scanline_mode) tile_scheduler.finish();
+
+    batch_tiles.clear();
+
+    //pick the tiles to draw this update
+    if(scanline_mode && !relit_only && !converged) {
 
+        if(tile_scheduler.hasMeasurements()) {
+
+            //as many tiles as the GPU timings of earlier batches say fit in a frame
+            tile_scheduler.nextBatch(budget_ms, batch_tiles);
 
             //try to meet rps target
-            if(scanline_target_rps > 0.0f && ((float)render_height)*scanline_target_rps > ((float)scanline_batch_size)/dt) {
-                scanline_batch_size++;
+            if(scanline_target_rps > 0.0f) {
+                int tiles_needed = (int) ceilf(tile_scheduler.getTileCount() * scanline_target_rps * dt) - (int) batch_tiles.size();
+
+                if(tiles_needed > 0) {
+                    std::vector<RenderTile> extra_tiles;
+                    tile_scheduler.nextBatch(tiles_needed, extra_tiles);
+                    batch_tiles.insert(batch_tiles.end(), extra_tiles.begin(), extra_tiles.end());
+                }
+            }
+
+            scanline_batch_size = batch_tiles.size();
+
+        } else {
+
+            if(scanline_batch_size == 0) {
+                scanline_batch_size = 1;
+            } else {
+                //adjust the number of tiles to render
+                //based on whether or not we are meeting our rps/fps targets
 
-            //try to meet fps target
-            } else if(dt > (1.0f/scanline_target_fps))
-                scanline_batch_size--;
-            else
-                scanline_batch_size++;
+                //try to meet rps target
+                if(scanline_target_rps > 0.0f && ((float)tile_scheduler.getTileCount())*scanline_target_rps > ((float)scanline_batch_size)/dt) {
+                    scanline_batch_size++;
 
-            if(scanline_batch_size<1) scanline_batch_size = 1;
+                //try to meet fps target
+                } else if(dt > (1.0f/scanline_target_fps))
+                    scanline_batch_size--;
+                else
+                    scanline_batch_size++;
+
+                if(scanline_batch_size<1) scanline_batch_size = 1;
+            }
+
+            tile_scheduler.nextBatch(scanline_batch_size, batch_tiles);
         }
+    }
 
-        //render the minimum of the remaining number of lines, and the batch size
-        int lines_to_render = std::min(scanline_batch_size, render_height - scanline_count);
+    int marched_area = render_width * render_height;
 
-        glEnable(GL_SCISSOR_TEST);
-        glScissor(0, display.height - render_height + scanline_count, render_width, lines_to_render);
+    if(!batch_tiles.empty()) {
+        marched_area = 0;
 
-        scanline_count += lines_to_render;
+        for(size_t i = 0; i < batch_tiles.size(); i++) marched_area += batch_tiles[i].w * batch_tiles[i].h;
     }
 
-    //render
-    drawAlignedQuad(render_width, render_height);
+    //only time the passes that march, relighting costs next to nothing
+    marched_pixels = (converged || relit_only) ? 0.0f : (float) marched_area;
 
-    //disable clipping
-    if(scanline_mode) glDisable(GL_SCISSOR_TEST);
+    if(marched_pixels > 0.0f && march_timer.begin(marched_pixels)) {
+        if(batch_tiles.empty()) {
+            tile_scheduler.issued(std::vector<RenderTile>(1, RenderTile(0, 0, render_width, render_height)), render_width, render_height);
+        } else {
+            tile_scheduler.issued(batch_tiles, render_width, render_height);
+        }
+    }
 
-    //stop using shader
-    glUseProgramObjectARB(0);
+    //render, unless the average already has all its samples
+    if(converged) {
+        uniform_uploads = 0;
+    } else if(jittered) {
+        useShader(SHADER_PROGRESSIVE);
 
-    glEnable(GL_TEXTURE_2D);
-    glDisable(GL_BLEND);
+        shader->setVec2("jitter", progressiveJitter(accumulated_samples));
 
-    bool resize_frame = display.width != render_width && display.height != render_height;
+        drawRegion(render_width, render_height);
+    } else if(deferred) {
+        drawDeferred(relit_only);
+    } else {
+        useShader();
+        drawRegion(render_width, render_height);
+    }
 
-    if(scanline_mode || resize_frame) {
+    if(marched_pixels > 0.0f) march_timer.end();
 
-        //render to either working or completed texture depending on progress
-        GLuint render_target = rendertex;
+    //stop using shader
+    glUseProgramObjectARB(0);
 
-        if(scanline_mode && scanline_count >= render_height) {
-            render_target = frametex;
-        } else {
-            render_target = rendertex;
-        }
+    bool frame_finished = !converged && (!scanline_mode || tile_scheduler.finished());
 
-        glBindTexture(GL_TEXTURE_2D, render_target);
-        glCopyTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 0, display.height - render_height, render_width, render_height, 0);
+    if(!use_targets) {
+        if(frame_finished) accumulateFrame();
 
-        display.mode2D();
+        picture_final = accumulated_samples >= samples_needed;
+        return;
+    }
 
-        //redraw last finished frame
-        if(scanline_mode && (scanline_debug || render_target != frametex) || resize_frame) {
+    RenderTarget::unbind();
 
-            if(scanline_mode && render_target != frametex)
-                glBindTexture(GL_TEXTURE_2D, frametex);
+    //the finished frame becomes the one displayed, the previous one is drawn over next
+    if(frame_finished) {
+        std::swap(progress_target, frame_target);
 
-            glColor4f(1.0f, 1.0f, 1.0f, scanline_debug ? 0.5f : 1.0f);
+        accumulateFrame();
+    }
 
-            glBegin(GL_QUADS);
-                glTexCoord2i(1,0);
-                glVertex2i(display.width,display.height);
+    picture_final = accumulated_samples >= samples_needed;
 
-                glTexCoord2i(0,0);
-                glVertex2i(0,display.height);
+    glDisable(GL_BLEND);
 
-                glTexCoord2i(0,1);
-                glVertex2i(0,0);
+    //redraw last finished frame, or the average of them
+    glColor4f(1.0f, 1.0f, 1.0f, scanline_debug ? 0.5f : 1.0f);
 
-                glTexCoord2i(1,1);
-                glVertex2i(display.width,0);
-            glEnd();
+    if(progressive && accumulated_samples > 0) {
+        accumulation.draw();
+    } else {
+        frame_target->draw();
+    }
 
-            //draw the rendered portion over the top so we can see the progress
-            if(scanline_mode && scanline_debug && scanline_count < render_height) {
-                glBindTexture(GL_TEXTURE_2D, render_target);
+    //draw the rendered portion over the top so we can see the progress
+    if(scanline_mode && scanline_debug && !tile_scheduler.finished()) {
 
-                glColor4f(1.0f, 1.0f, 1.0f, 1.0f);
+        glColor4f(1.0f, 1.0f, 1.0f, 1.0f);
 
-                glEnable(GL_BLEND);
-                glBlendFunc(GL_ONE, GL_ONE);
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_ONE, GL_ONE);
 
-                glBegin(GL_QUADS);
-                    glTexCoord2i(1,0);
-                    glVertex2i(display.width,display.height);
+        progress_target->draw();
+    }
 
-                    glTexCoord2i(0,0);
-                    glVertex2i(0,display.height);
+    //outline the tiles drawn this update and those still being timed
+    if(scanline_mode && scanline_debug) {
+        glDisable(GL_BLEND);
 
-                    glTexCoord2i(0,1);
-                    glVertex2i(0,0);
+        const std::deque<TileBatch>& in_flight = tile_scheduler.getInFlight();
 
-                    glTexCoord2i(1,1);
-                    glVertex2i(display.width,0);
-                glEnd();
-            }
+        glColor4f(1.0f, 0.5f, 0.0f, 1.0f);
 
+        for(std::deque<TileBatch>::const_iterator it = in_flight.begin(); it != in_flight.end(); it++) {
+            drawTileOutlines(it->tiles, it->width, it->height);
         }
 
-    }
+        glColor4f(0.0f, 1.0f, 0.0f, 1.0f);
 
-    // TODO: why is the first frame corrupt?
-    if(scanline_mode && frame_count<2) display.clear();
+        drawTileOutlines(batch_tiles, render_width, render_height);
+    }
 }
 
 void MandelbulbViewer::draw(float t, float dt) {
@@ -1114,8 +1685,33 @@ void MandelbulbViewer::draw(float t, float dt) {
         font.print(0, 120,"aoSteps: %.5f", gViewerSettings.aoSteps);
         font.print(0, 140,"dt: %.5f", dt);
 
+        font.print(0, 160,"shader: %.0f ms (%s)", shader->getLoadTime(), shader->isCached() ? "cached" : "compiled");
+        font.print(0, 180,"uniforms uploaded: %d%s", uniform_uploads, relit_only ? " (relit only)" : "");
+
         if(scanline_mode) {
-            font.print(0, 160, "rps: %.2f, %d / %d (batch: %d)", ((float)scanline_batch_size / dt)/(float)render_height, scanline_count, render_height, scanline_batch_size);
+            int tile_count = std::max(1, tile_scheduler.getTileCount());
+
+            font.print(0, 200, "rps: %.2f, tiles: %d / %d (batch: %d, in flight: %d, predicted: %.1f ms, error: %.1f ms)", ((float)scanline_batch_size / dt)/(float)tile_count,
+                tile_scheduler.getTilesDone(), tile_scheduler.getTileCount(), scanline_batch_size, (int) tile_scheduler.getInFlight().size(),
+                tile_scheduler.getPrediction(), tile_scheduler.getError());
+        }
+
+        if(progressiveEnabled()) {
+            font.print(0, 220, "samples: %d / %d, skipped frames: %d", accumulated_samples, gViewerSettings.progressive_samples, skipped_frames);
+        } else if(frameExporter == 0) {
+            font.print(0, 220, "skipped frames: %d", skipped_frames);
+        }
+
+        float full_pixels = (display.width * gViewerSettings.viewscale) * (display.height * gViewerSettings.viewscale);
+
+        font.print(0, 260, "render scale: %.2f (%dx%d), predicted frame: %.1f ms%s", getRenderScale(), render_width, render_height,
+            resolution.getFrameTime(full_pixels), GPUTimer::supported() ? "" : " (cpu timed)");
+
+        if(frameExporter != 0) {
+            font.print(0, 220, "export: %.2f fps", frameExporter->getExportFPS());
+            font.print(0, 240, "export queue: %d / %d (peak %d), stalled: %.2f s, dropped: %d",
+                frameExporter->getQueueDepth(), frameExporter->getQueueCapacity(), frameExporter->getPeakQueueDepth(),
+                frameExporter->getStallTime(), frameExporter->getDroppedFrames());
         }
     }
 
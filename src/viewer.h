@@ -28,10 +28,42 @@
 #include "core/mousecursor.h"
 
 #include "viewer_settings.h"
+#include "viewer_uniforms.h"
+#include "uniform_block.h"
+#include "render_target.h"
+#include "gpu_timer.h"
+#include "resolution_controller.h"
+#include "tile_scheduler.h"
+#include "headless.h"
 
 #include "vcamera.h"
 #include "ppm.h"
 
+#include <map>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+//largest tile rendered at once by renderPoster()
+#define POSTER_TILE_SIZE 512
+
+//features compiled into the shader with #defines
+enum {
+    SHADER_JULIA               = 1 << 0,
+    SHADER_PHONG               = 1 << 1,
+    SHADER_RADIOLARIA          = 1 << 2,
+    SHADER_SHADOWS             = 1 << 3,
+    SHADER_PULSE               = 1 << 4,
+    SHADER_RAVE                = 1 << 5,
+    SHADER_BACKGROUND_GRADIENT = 1 << 6,
+    SHADER_ANTIALIASING        = 1 << 7,
+    SHADER_INTEGER_POWER       = 1 << 8,
+    SHADER_GBUFFER_PASS        = 1 << 9,
+    SHADER_LIGHTING_PASS       = 1 << 10,
+    SHADER_PROGRESSIVE         = 1 << 11
+};
+
 class MandelbulbViewer : public SDLApp {
 
     bool mousemove;
@@ -40,6 +72,9 @@ class MandelbulbViewer : public SDLApp {
     int render_height;
 
     Shader* shader;
+    MandelbulbUniformBlock* uniform_block;
+    std::map<int, MandelbulbUniformBlock*> shader_variants;
+    int uniform_uploads;
     FXFont font;
 
     bool debug;
@@ -49,26 +84,35 @@ class MandelbulbViewer : public SDLApp {
     vec3f message_colour;
 
 
-    float time_elapsed;
-
     bool play;
     bool record;
     int record_frame_skip;
     float record_frame_delta;
     FrameExporter* frameExporter;
+    ScreenshotExporter* screenshotExporter;
+
+    FILE* frame_time_log;
+    int log_frame;
 
     float runtime;
     float fixed_tick_rate;
 
+    //frames of the recording exported (or skipped) so far
+    int export_frame;
+
     int frame_skip;
     int frame_count;
     int last_frame;
 
     bool scanline_mode;
     bool scanline_debug;
-    int  scanline_count;
     int  scanline_batch_size;
 
+    //the frame drawn over several updates is split into tiles
+    TileScheduler tile_scheduler;
+    std::vector<RenderTile> batch_tiles;
+    FILE* scanline_log;
+
     float scanline_target_fps;
     float scanline_target_rps;
 
@@ -85,20 +129,14 @@ class MandelbulbViewer : public SDLApp {
     bool render_depth;
 
     ViewCamera view;
-    Object3D mandelbulb;
 
     mat3f viewRotation;
     mat3f objRotation;
 
     float speed;
 
-    float beatTimer;
-    int   beatCount;
-    float beatGlowDepth;
-    float beatGlowMulti;
-    float pulse;
-
-    vec3f _julia_c;
+    MandelbulbAnimation animation;
+    MandelbulbUniforms uniforms;
 
     void randomizeJuliaSeed();
     void randomizeColours();
@@ -117,11 +155,66 @@ class MandelbulbViewer : public SDLApp {
     void setMessage(const std::string& message, const vec3f& colour = vec3f(1.0, 1.0, 1.0));
     void setDefaults();
 
-    GLuint rendertex;
-    GLuint frametex;
+    RenderTarget render_targets[2];
+    RenderTarget* progress_target;
+    RenderTarget* frame_target;
+
+    //march results, so colour changes only need the lighting pass
+    RenderTarget gbuffer;
+    bool gbuffer_supported;
+    bool gbuffer_complete;
+    bool gbuffer_mixed;
+    int  gbuffer_flags;
+    MandelbulbUniforms gbuffer_uniforms;
+    bool relit_only;
+
+    //average of jittered frames while the view is still
+    RenderTarget accumulation;
+    int  accumulated_samples;
+    bool accumulation_mixed;
+    int  accumulated_flags;
+    MandelbulbUniforms accumulated_uniforms;
+
+    //the displayed picture is final until something changes
+    bool picture_final;
+    bool frame_skipped;
+    int  skipped_frames;
+
+    //render size follows the cost of marching while the camera moves
+    GPUTimer march_timer;
+    ResolutionController resolution;
+    float marched_pixels;
+
+    vec3f last_campos;
+    mat3f last_view_rotation;
+    mat3f last_obj_rotation;
+
+    float getRenderScale();
+    void updateResolution(float dt);
 
     void drawAlignedQuad(int w, int h);
+    void drawRegion(int w, int h);
+    void drawTileOutlines(const std::vector<RenderTile>& tiles, int w, int h);
+
+    int getShaderFlags();
+    MandelbulbUniformBlock* getShaderVariant(int pass_flags = 0);
+
+    std::string poster_filename;
+    int poster_width;
+    int poster_height;
+
+    void renderPoster();
+
+    void prepareExport(int video_framerate);
+
+    void updateUniforms(int width, int height);
+    void useShader(int pass_flags = 0);
+    bool gbufferCurrent(int flags);
+    void drawDeferred(bool relight);
 
+    bool progressiveEnabled();
+    void updateAccumulation(int flags);
+    void accumulateFrame();
     void drawMandelbulb(float dt);
 public:
     MandelbulbViewer(ConfFile& conf);
@@ -129,8 +222,11 @@ public:
 
     void logic(float t, float dt);
     void draw(float t, float dt);
+    bool isIdle();
 
-    void createVideo(std::string filename, int video_framerate);
+    void createVideo(std::string filename, int video_framerate, bool y4m = false);
+    void createImageSequence(std::string pattern, int video_framerate);
+    void createPoster(std::string filename, int width, int height);
 
     void saveRecording();
     void screenshot();
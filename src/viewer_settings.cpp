@@ -16,6 +16,9 @@
 */
 
 #include "viewer_settings.h"
+#include "cpu_tile_pool.h"
+
+#include <time.h>
 
 MandelbulbViewerSettings gViewerSettings;
 
@@ -40,10 +43,57 @@ void MandelbulbViewerSettings::help() {
 
     printf("  --multi-sampling         Enable multi-sampling\n\n");
 
-    printf("  --shader SHADER          Use an alternate shader\n\n");
+    printf("  --frame-time-log FILE    Log the time taken by each frame\n");
+    printf("  --scanline-log FILE      Log the predicted and measured GPU time of\n");
+    printf("                           each batch of tiles\n\n");
+
+    printf("  --tile-size N            Size of the tiles a frame is drawn in over\n");
+    printf("                           several updates (default: 64)\n");
+    printf("  --tile-order ORDER       Order the tiles are drawn in (centre, hilbert)\n\n");
+
+    printf("  --progressive-samples N  Samples per pixel averaged while the view is\n");
+    printf("                           still, 0 to disable (default: 64)\n\n");
+
+    printf("  --shader SHADER          Use an alternate shader\n");
+    printf("  --disable-shader-cache   Always compile shaders instead of loading\n");
+    printf("                           cached program binaries\n\n");
+
+    printf("  --headless               Render on the CPU without opening a window\n");
+    printf("                           (requires --output-ppm-stream)\n");
+    printf("  --cpu-kernel KERNEL      Ray marching kernel used by --headless\n");
+    printf("                           (reference, scalar, sse4.2, avx2, avx512, auto)\n");
+    printf("  --cpu-threads N          Threads used by --headless (default: one per\n");
+    printf("                           processor)\n");
+    printf("  --cpu-stats              Print the work done by each thread on exit\n\n");
+
+    printf("  --output-poster FILE     Render the view to a PNG or PPM file in tiles\n");
+    printf("  --poster-size WxH        Size of the poster (default: 4x the window size)\n\n");
 
     printf("  --output-ppm-stream FILE Write frames as PPM to a file ('-' for STDOUT)\n");
-    printf("  --output-framerate FPS   Framerate of output (25,30,60)\n\n");
+    printf("  --output-y4m-stream FILE Write frames as YUV 4:2:0 Y4M ('-' for STDOUT)\n");
+    printf("  --output-images PATTERN  Write frames as numbered PNG or QOI files\n");
+    printf("                           (eg frame-%%05d.png or frame-%%05d.qoi)\n");
+    printf("  --output-compression N   PNG compression level 0-9 (default: 6)\n");
+    printf("  --output-framerate FPS   Framerate of output (25,30,60)\n");
+    printf("  --output-queue-depth N   Frames queued for writing before rendering\n");
+    printf("                           waits (default: 4)\n");
+    printf("  --output-threads N       Threads preparing frames for output\n");
+    printf("                           (default: 1, or 4 for --output-images)\n\n");
+
+    printf("  --frame-range FIRST-LAST Only output these frames of a recording\n");
+    printf("                           (eg 1-500, or 501- for the rest)\n");
+    printf("  --shard I/N              Only output part I of N of a recording, so\n");
+    printf("                           N processes can render it in parallel.\n");
+    printf("                           Image files keep their frame numbers, PPM\n");
+    printf("                           and Y4M parts can be joined with cat\n");
+    printf("  --seed N                 Seed of the random colours (default: 1 when\n");
+    printf("                           writing frames, otherwise random)\n\n");
+
+    printf("  --path-tolerance X       How far (in units and radians) a saved camera\n");
+    printf("                           path may stray from the recorded one to\n");
+    printf("                           use fewer waypoints (default: 0.001)\n");
+    printf("  --compact-recording FILE Write the recording given as FILE to this\n");
+    printf("                           file with its camera path simplified\n\n");
 
     printf("FILE may be a Mandelbulb conf file or a recording file.\n\n");
 
@@ -62,9 +112,43 @@ MandelbulbViewerSettings::MandelbulbViewerSettings() {
 
     //command line only options
     conf_sections["help"]      = "command-line";
+    conf_sections["headless"]  = "command-line";
+    conf_sections["cpu-kernel"] = "command-line";
+    conf_sections["cpu-threads"] = "command-line";
+    conf_sections["cpu-stats"]  = "command-line";
+    conf_sections["disable-shader-cache"] = "command-line";
+    conf_sections["output-poster"] = "command-line";
+    conf_sections["poster-size"]   = "command-line";
+    conf_sections["frame-time-log"] = "command-line";
+    conf_sections["scanline-log"]   = "command-line";
+    conf_sections["progressive-samples"] = "command-line";
+    conf_sections["frame-range"]    = "command-line";
+    conf_sections["shard"]          = "command-line";
+    conf_sections["seed"]           = "command-line";
+    conf_sections["tile-size"]      = "command-line";
+    conf_sections["tile-order"]     = "command-line";
+    conf_sections["path-tolerance"] = "command-line";
+    conf_sections["compact-recording"] = "command-line";
 
     //boolean args
     arg_types["help"]             = "bool";
+    arg_types["headless"]         = "bool";
+    arg_types["cpu-kernel"]       = "string";
+    arg_types["cpu-threads"]      = "int";
+    arg_types["cpu-stats"]        = "bool";
+    arg_types["disable-shader-cache"] = "bool";
+    arg_types["output-poster"]    = "string";
+    arg_types["poster-size"]      = "string";
+    arg_types["frame-time-log"]   = "string";
+    arg_types["scanline-log"]     = "string";
+    arg_types["progressive-samples"] = "int";
+    arg_types["frame-range"]      = "string";
+    arg_types["shard"]            = "string";
+    arg_types["seed"]             = "int";
+    arg_types["tile-size"]        = "int";
+    arg_types["tile-order"]       = "string";
+    arg_types["path-tolerance"]   = "float";
+    arg_types["compact-recording"] = "string";
 
     arg_types["shader"]           = "string";
     arg_types["viewscale"]        = "float";
@@ -113,12 +197,164 @@ void MandelbulbViewerSettings::commandLineOption(const std::string& name, const
         help();
     }
 
+    if(name == "headless") {
+        headless = true;
+    }
+
+    if(name == "disable-shader-cache") {
+        shader_cache = false;
+    }
+
+    if(name == "cpu-kernel") {
+        if(!cpuKernelFromName(value, cpu_kernel)) {
+            std::string invalid_kernel = std::string("invalid cpu-kernel value ") + value;
+            throw ConfFileException(invalid_kernel, "", 0);
+        }
+    }
+
+    if(name == "cpu-threads") {
+        cpu_threads = atoi(value.c_str());
+
+        if(cpu_threads < 1 || cpu_threads > CPU_TILE_POOL_MAX_THREADS) {
+            std::string invalid_threads = std::string("invalid cpu-threads value ") + value;
+            throw ConfFileException(invalid_threads, "", 0);
+        }
+    }
+
+    if(name == "cpu-stats") {
+        cpu_stats = true;
+    }
+
+    if(name == "output-poster") {
+        if(value.size() < 5 || (value.substr(value.size()-4) != ".png" && value.substr(value.size()-4) != ".ppm")) {
+            throw ConfFileException("poster file must end in .png or .ppm", "", 0);
+        }
+        poster_filename = value;
+    }
+
+    if(name == "frame-time-log") {
+        frame_time_log = value;
+    }
+
+    if(name == "scanline-log") {
+        scanline_log = value;
+    }
+
+    if(name == "tile-size") {
+        tile_size = atoi(value.c_str());
+
+        if(tile_size < 8) {
+            std::string invalid_size = std::string("invalid tile-size value ") + value;
+            throw ConfFileException(invalid_size, "", 0);
+        }
+    }
+
+    if(name == "tile-order") {
+        if(!TileScheduler::orderFromName(value, tile_order)) {
+            std::string invalid_order = std::string("invalid tile-order value ") + value;
+            throw ConfFileException(invalid_order, "", 0);
+        }
+    }
+
+    if(name == "progressive-samples") {
+        progressive_samples = atoi(value.c_str());
+
+        if(progressive_samples < 0 || (progressive_samples == 0 && value != "0")) {
+            std::string invalid_samples = std::string("invalid progressive-samples value ") + value;
+            throw ConfFileException(invalid_samples, "", 0);
+        }
+    }
+
+    if(name == "frame-range") {
+        char dash;
+        int last = 0;
+
+        int fields = sscanf(value.c_str(), "%d%c%d", &frame_first, &dash, &last);
+
+        if(fields < 2 || dash != '-' || frame_first < 1 || (fields == 3 && last < frame_first)) {
+            std::string invalid_range = std::string("invalid frame-range value ") + value;
+            throw ConfFileException(invalid_range, "", 0);
+        }
+
+        frame_last = fields == 3 ? last : 0;
+    }
+
+    if(name == "shard") {
+        char slash;
+
+        if(sscanf(value.c_str(), "%d%c%d", &shard_index, &slash, &shard_count) != 3 || slash != '/'
+            || shard_count < 1 || shard_index < 1 || shard_index > shard_count) {
+            std::string invalid_shard = std::string("invalid shard value ") + value;
+            throw ConfFileException(invalid_shard, "", 0);
+        }
+    }
+
+    if(name == "seed") {
+        int value_seed = atoi(value.c_str());
+
+        if(value_seed < 1) {
+            std::string invalid_seed = std::string("invalid seed value ") + value;
+            throw ConfFileException(invalid_seed, "", 0);
+        }
+
+        seed = value_seed;
+    }
+
+    if(name == "path-tolerance") {
+        path_tolerance = atof(value.c_str());
+
+        if(path_tolerance < 0.0f) {
+            std::string invalid_tolerance = std::string("invalid path-tolerance value ") + value;
+            throw ConfFileException(invalid_tolerance, "", 0);
+        }
+    }
+
+    if(name == "compact-recording") {
+        compact_recording = value;
+    }
+
+    if(name == "poster-size") {
+        if(!parseRectangle(value, &poster_width, &poster_height) || poster_width <= 0 || poster_height <= 0) {
+            std::string invalid_size = std::string("invalid poster-size value ") + value;
+            throw ConfFileException(invalid_size, "", 0);
+        }
+    }
+
 }
 
 void MandelbulbViewerSettings::setViewerDefaults() {
 
     shader = "MandelbulbQuick";
 
+    headless = false;
+    cpu_kernel = CPU_KERNEL_AUTO;
+    cpu_threads = 0;
+    cpu_stats   = false;
+
+    shader_cache = true;
+
+    poster_filename = "";
+    frame_time_log  = "";
+    scanline_log    = "";
+
+    tile_size  = 64;
+    tile_order = TILE_ORDER_CENTRE;
+
+    progressive_samples = 64;
+
+    frame_first = 1;
+    frame_last  = 0;
+    shard_index = 0;
+    shard_count = 0;
+
+    seed = 0;
+
+    path_tolerance    = 0.001f;
+    compact_recording = "";
+
+    poster_width    = 0;
+    poster_height   = 0;
+
     viewscale = 1.0;
     timescale = 1.0;
 
@@ -179,6 +415,38 @@ void MandelbulbViewerSettings::setViewerDefaults() {
     pulseScale = 2.0f;
 }
 
+bool MandelbulbViewerSettings::resolveFrameRange(int frame_count) {
+
+    if(shard_count <= 0 && frame_first == 1 && frame_last == 0) return true;
+
+    //a looping or empty path never finishes, so every process would get the same frames
+    if(frame_count <= 0) return false;
+
+    if(shard_count <= 0) return true;
+
+    //split the frames as evenly as possible, the parts adding up to the whole
+    frame_first = (int) ((long long) frame_count * (shard_index-1) / shard_count) + 1;
+    frame_last  = (int) ((long long) frame_count * shard_index / shard_count);
+
+    //an empty shard still has to stop before any frames
+    if(frame_last < frame_first) {
+        frame_first = frame_count + 1;
+        frame_last  = frame_count + 1;
+    }
+
+    return true;
+}
+
+bool MandelbulbViewerSettings::exporting() const {
+    return headless || !output_ppm_filename.empty() || !output_y4m_filename.empty() || !output_image_pattern.empty();
+}
+
+unsigned int MandelbulbViewerSettings::getSeed() const {
+    if(seed != 0) return seed;
+
+    return exporting() ? 1 : (unsigned int) time(0);
+}
+
 void MandelbulbViewerSettings::importViewerSettings(ConfFile& conf) {
 
     ConfSection* settings = conf.getSection("mandelbulb");
@@ -20,6 +20,9 @@
 
 #include "core/settings.h"
 
+#include "cpu_simd.h"
+#include "tile_scheduler.h"
+
 #define MANDELBULB_VIEWER_VERSION "0.2"
 
 class MandelbulbViewerSettings : public SDLAppSettings {
@@ -29,7 +32,40 @@ public:
     float timescale;
     float viewscale;
 
+    bool headless;
+    CPUKernelType cpu_kernel;
+    int  cpu_threads;
+    bool cpu_stats;
+
     std::string shader;
+    bool shader_cache;
+
+    std::string frame_time_log;
+    std::string scanline_log;
+
+    int tile_size;
+    TileOrder tile_order;
+
+    int progressive_samples;
+
+    //frames of a recording to export (1 based, 0 for the last)
+    int frame_first;
+    int frame_last;
+
+    //part of the recording to export when split between processes
+    int shard_index;
+    int shard_count;
+
+    //seed of the random colours (0 to pick one)
+    unsigned int seed;
+
+    //how far a saved camera path may stray from the recorded one
+    float path_tolerance;
+    std::string compact_recording;
+
+    std::string poster_filename;
+    int poster_width;
+    int poster_height;
 
     bool backgroundGradient;
     bool juliaset;
@@ -99,6 +135,17 @@ public:
     void importViewerSettings(ConfFile& conf);
     void exportViewerSettings(ConfFile& conf);
 
+    // narrow the frame range to this process's shard of frame_count frames,
+    // returns false if a range was asked for but there are no frames to count
+    bool resolveFrameRange(int frame_count);
+
+    // true if frames are being written out rather than shown
+    bool exporting() const;
+
+    // the seed to use, fixed when exporting so every process rendering
+    // part of a recording (on the GPU or the CPU) picks the same colours
+    unsigned int getSeed() const;
+
     void help();
 };
 
@@ -0,0 +1,240 @@
+/*
+    Copyright (C) 2010 Andrew Caudwell (acaudwell@gmail.com)
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version
+    3 of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "viewer_uniforms.h"
+#include "viewer_settings.h"
+
+#include "core/pi.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+MandelbulbUniforms::MandelbulbUniforms() {
+    width  = 0.0f;
+    height = 0.0f;
+    pulse  = -1.0f;
+
+    render_depth = 0.0f;
+}
+
+void MandelbulbUniforms::update(const MandelbulbViewerSettings& settings, float pulse) {
+
+    cameraFine = vec3f(0.0f, 0.0f, 0.0f);
+    cameraZoom = settings.cameraZoom;
+
+    julia            = settings.juliaset;
+    radiolaria       = settings.radiolaria;
+    radiolariaFactor = settings.radiolariaFactor;
+
+    power    = settings.power;
+
+    //whole number powers use the trig free powN
+    intPower = (power >= 1.0f && floorf(power) == power) ? (int) power : 0;
+
+    bounding = settings.bounding;
+    bailout  = settings.bailout;
+
+    antialiasing = settings.antialiasing;
+
+    phong   = settings.phong;
+    shadows = settings.shadows;
+
+    ambientOcclusion         = settings.ambientOcclusion;
+    ambientOcclusionEmphasis = settings.ambientOcclusionEmphasis;
+
+    colorSpread      = settings.colorSpread;
+    rimLight         = settings.rimLight;
+    specularity      = settings.specularity;
+    specularExponent = settings.specularExponent;
+
+    light = settings.light;
+
+    backgroundColor = settings.backgroundColor;
+    diffuseColor    = settings.diffuseColor;
+    ambientColor    = settings.ambientColor;
+    lightColor      = settings.lightColor;
+
+    maxIterations = settings.maxIterations;
+    stepLimit     = settings.stepLimit;
+    epsilonScale  = settings.epsilonScale;
+
+    aoSteps     = settings.aoSteps;
+    fogDistance = settings.fogDistance;
+
+    //glow throbs with the beat
+    if(settings.beat>0.0) {
+        glowDepth = settings.glowDepth * 0.5 + 0.5 * settings.glowDepth * pulse;
+        glowMulti = settings.glowMulti * 0.5 + 0.5 * settings.glowMulti * pulse;
+    } else {
+        glowDepth = settings.glowDepth;
+        glowMulti = settings.glowMulti;
+    }
+
+    glowColour = settings.glowColour;
+
+    rave       = settings.rave;
+    this->pulse = settings.pulsate ? pulse : -1.0f;
+    pulseScale = settings.pulseScale;
+
+    backgroundGradient = settings.backgroundGradient;
+
+    if(!settings.pulsateFov) {
+        fov = settings.fov;
+    } else {
+        fov = settings.fov * sinf(pulse*0.5+0.5) * settings.pulseFovScale;
+    }
+}
+
+bool MandelbulbUniforms::sameGeometry(const MandelbulbUniforms& other) const {
+
+    if(width != other.width || height != other.height) return false;
+
+    if(julia != other.julia || radiolaria != other.radiolaria || phong != other.phong) return false;
+
+    if(radiolariaFactor != other.radiolariaFactor
+       || bounding != other.bounding || bailout != other.bailout
+       || power != other.power || intPower != other.intPower
+       || cameraZoom != other.cameraZoom || fov != other.fov
+       || maxIterations != other.maxIterations || stepLimit != other.stepLimit
+       || epsilonScale != other.epsilonScale
+       || pulse != other.pulse || pulseScale != other.pulseScale) return false;
+
+    if(memcmp(&julia_c, &other.julia_c, sizeof(vec3f))
+       || memcmp(&camera, &other.camera, sizeof(vec3f))
+       || memcmp(&cameraFine, &other.cameraFine, sizeof(vec3f))
+       || memcmp(&viewRotation, &other.viewRotation, sizeof(mat3f))
+       || memcmp(&objRotation, &other.objRotation, sizeof(mat3f))) return false;
+
+    //the light only matters to the march when a shadow ray is cast towards it
+    bool casts_shadows = phong && shadows > 0.0f;
+
+    if(casts_shadows != (other.phong && other.shadows > 0.0f)) return false;
+
+    if(casts_shadows && memcmp(&light, &other.light, sizeof(vec3f))) return false;
+
+    return true;
+}
+
+bool MandelbulbUniforms::sameImage(const MandelbulbUniforms& other) const {
+
+    if(!sameGeometry(other)) return false;
+
+    if(antialiasing != other.antialiasing || rave != other.rave
+       || backgroundGradient != other.backgroundGradient) return false;
+
+    if(shadows != other.shadows
+       || ambientOcclusion != other.ambientOcclusion
+       || ambientOcclusionEmphasis != other.ambientOcclusionEmphasis
+       || colorSpread != other.colorSpread || rimLight != other.rimLight
+       || specularity != other.specularity || specularExponent != other.specularExponent
+       || aoSteps != other.aoSteps || fogDistance != other.fogDistance
+       || glowDepth != other.glowDepth || glowMulti != other.glowMulti) return false;
+
+    if(memcmp(&light, &other.light, sizeof(vec3f))
+       || memcmp(&backgroundColor, &other.backgroundColor, sizeof(vec4f))
+       || memcmp(&diffuseColor, &other.diffuseColor, sizeof(vec4f))
+       || memcmp(&ambientColor, &other.ambientColor, sizeof(vec4f))
+       || memcmp(&lightColor, &other.lightColor, sizeof(vec4f))
+       || memcmp(&glowColour, &other.glowColour, sizeof(vec3f))) return false;
+
+    return true;
+}
+
+// MandelbulbAnimation
+
+MandelbulbAnimation::MandelbulbAnimation() {
+    time_elapsed = 0.0f;
+
+    beatTimer = 0.0f;
+    beatCount = 0;
+    pulse     = -1.0f;
+
+    julia_c = vec3f(0.0f, 0.0f, 0.0f);
+
+    random_state = 1;
+
+    mandelbulb.setPos(vec3f(0.0, 0.0, 0.0));
+    mandelbulb.rotateX(90.0f * DEGREES_TO_RADIANS);
+}
+
+void MandelbulbAnimation::setSeed(unsigned int seed) {
+    random_state = seed;
+}
+
+// the same sequence on every platform, 0 to 32767
+
+int MandelbulbAnimation::random() {
+    random_state = random_state * 1103515245 + 12345;
+
+    return (random_state >> 16) & 0x7fff;
+}
+
+void MandelbulbAnimation::logic(MandelbulbViewerSettings& settings, float dt, const vec3f& camera_pos) {
+
+    time_elapsed += dt;
+
+    //update beat
+    if(settings.beat>0.0) {
+        beatTimer += dt;
+
+        if(beatTimer>settings.beat*2.0) {
+            beatTimer=0.0;
+            beatCount++;
+
+            if(settings.beatPeriod>0 && beatCount % settings.beatPeriod == 0) {
+                //(in order, the order arguments are evaluated in is unspecified)
+                int r = random() % 100;
+                int g = random() % 100;
+                int b = random() % 100;
+
+                settings.glowColour = vec3f(r, g, b).normal();
+            }
+        }
+
+        pulse = beatTimer/settings.beat;
+
+        if(pulse>1.0) pulse = 2.0-pulse;
+    }
+
+    //update julia seed
+    julia_c = settings.julia_c;
+
+    if(settings.animated) {
+        julia_c = settings.julia_c + vec3f(sinf(time_elapsed), sinf(time_elapsed), atan(time_elapsed)) * 0.1;
+    }
+
+    //to avoid a visible sphere we need to set the bounding
+    //sphere to be greater than the camera's distance from the
+    //origin
+    if(settings.backgroundGradient) {
+        settings.bounding = std::max(settings.bounding, camera_pos.length2());
+    }
+
+    mandelbulb.rotateX(settings.rotation.x * dt * DEGREES_TO_RADIANS);
+    mandelbulb.rotateY(settings.rotation.y * dt * DEGREES_TO_RADIANS);
+    mandelbulb.rotateZ(settings.rotation.z * dt * DEGREES_TO_RADIANS);
+}
+
+void MandelbulbAnimation::update(const MandelbulbViewerSettings& settings, MandelbulbUniforms& uniforms) {
+
+    uniforms.update(settings, pulse);
+
+    uniforms.julia_c     = julia_c;
+    uniforms.objRotation = mandelbulb.getRotationMatrix();
+}
@@ -0,0 +1,126 @@
+/*
+    Copyright (C) 2010 Andrew Caudwell (acaudwell@gmail.com)
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version
+    3 of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef MANDELBULB_VIEWER_UNIFORMS_H
+#define MANDELBULB_VIEWER_UNIFORMS_H
+
+#include "core/matrix.h"
+
+#include "vcamera.h"
+
+class MandelbulbViewerSettings;
+
+// the values of the uniforms of MandelbulbQuick.frag for one frame,
+// shared by the GLSL and CPU renderers so they draw the same picture
+
+class MandelbulbUniforms {
+public:
+    float width;
+    float height;
+
+    int   antialiasing;
+    bool  phong;
+    bool  julia;
+    bool  radiolaria;
+
+    float shadows;
+    float radiolariaFactor;
+    float ambientOcclusion;
+    float ambientOcclusionEmphasis;
+    float bounding;
+    float bailout;
+    float power;
+    int   intPower;
+    vec3f julia_c;
+    vec3f camera;
+    vec3f cameraFine;
+    float cameraZoom;
+    vec3f light;
+    vec4f backgroundColor;
+    vec4f diffuseColor;
+    vec4f ambientColor;
+    vec4f lightColor;
+    float colorSpread;
+    float rimLight;
+    float specularity;
+    float specularExponent;
+    int   maxIterations;
+    int   stepLimit;
+    float epsilonScale;
+
+    float aoSteps;
+    float fogDistance;
+    float render_depth;
+    float glowDepth;
+    float glowMulti;
+    vec3f glowColour;
+
+    bool  rave;
+    float pulse;
+    float pulseScale;
+
+    mat3f viewRotation;
+    mat3f objRotation;
+
+    bool  backgroundGradient;
+    float fov;
+
+    MandelbulbUniforms();
+
+    // copy the values derived from the settings and the current beat pulse
+    void update(const MandelbulbViewerSettings& settings, float pulse);
+
+    // true if marching with either set of values finds the same surface,
+    // ie only the uniforms used to shade it differ
+    bool sameGeometry(const MandelbulbUniforms& other) const;
+
+    // true if both sets of values draw exactly the same picture
+    bool sameImage(const MandelbulbUniforms& other) const;
+};
+
+// the parts of the picture that change as time passes (the beat, the
+// animated julia seed and the rotation of the mandelbulb), shared by the
+// viewer and the headless renderer so both play a recording the same way
+
+class MandelbulbAnimation {
+public:
+    float time_elapsed;
+
+    float beatTimer;
+    int   beatCount;
+    float pulse;
+
+    vec3f julia_c;
+
+    Object3D mandelbulb;
+
+    //own random numbers, so the colours don't depend on other users of rand()
+    unsigned int random_state;
+
+    MandelbulbAnimation();
+
+    void setSeed(unsigned int seed);
+    int random();
+
+    // advance by dt seconds, seen from a camera at camera_pos
+    void logic(MandelbulbViewerSettings& settings, float dt, const vec3f& camera_pos);
+
+    // copy the derived settings and the animated values into the uniforms
+    void update(const MandelbulbViewerSettings& settings, MandelbulbUniforms& uniforms);
+};
+
+#endif
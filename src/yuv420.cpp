@@ -0,0 +1,81 @@
+/*
+    Copyright (C) 2010 Andrew Caudwell (acaudwell@gmail.com)
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version
+    3 of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "yuv420.h"
+#include "cpu_simd.h"
+
+static inline unsigned char yuv420Luma(int r, int g, int b) {
+    return ((66*r + 129*g + 25*b + 128) >> 8) + 16;
+}
+
+void yuv420Span(const unsigned char* row0, const unsigned char* row1, int x, int width,
+                unsigned char* y0, unsigned char* y1, unsigned char* u, unsigned char* v) {
+
+    for(;x<width;x+=2) {
+
+        //repeat the last column of an odd width
+        int x1 = x+1 < width ? x+1 : x;
+
+        const unsigned char* a0 = row0 + x  * 3;
+        const unsigned char* b0 = row0 + x1 * 3;
+        const unsigned char* a1 = row1 + x  * 3;
+        const unsigned char* b1 = row1 + x1 * 3;
+
+        y0[x] = yuv420Luma(a0[0], a0[1], a0[2]);
+        if(x1 != x) y0[x1] = yuv420Luma(b0[0], b0[1], b0[2]);
+
+        if(y1 != 0) {
+            y1[x] = yuv420Luma(a1[0], a1[1], a1[2]);
+            if(x1 != x) y1[x1] = yuv420Luma(b1[0], b1[1], b1[2]);
+        }
+
+        //average the rows then the columns, rounding up as the SIMD kernels do
+        int r = (((a0[0] + a1[0] + 1) >> 1) + ((b0[0] + b1[0] + 1) >> 1) + 1) >> 1;
+        int g = (((a0[1] + a1[1] + 1) >> 1) + ((b0[1] + b1[1] + 1) >> 1) + 1) >> 1;
+        int b = (((a0[2] + a1[2] + 1) >> 1) + ((b0[2] + b1[2] + 1) >> 1) + 1) >> 1;
+
+        u[x>>1] = (-38*r -  74*g + 112*b + 32896) >> 8;
+        v[x>>1] = (112*r -  94*g -  18*b + 32896) >> 8;
+    }
+}
+
+void rgbToYUV420Scalar(const unsigned char* rgb, ptrdiff_t stride, int width, int height,
+                       unsigned char* y, unsigned char* u, unsigned char* v) {
+
+    int chroma_width = (width+1)/2;
+
+    for(int j=0;j<height;j+=2) {
+
+        const unsigned char* row0 = rgb + j * stride;
+        const unsigned char* row1 = j+1 < height ? row0 + stride : row0;
+
+        unsigned char* y1 = j+1 < height ? y + (j+1) * width : 0;
+
+        yuv420Span(row0, row1, 0, width, y + j * width, y1, u + (j/2) * chroma_width, v + (j/2) * chroma_width);
+    }
+}
+
+size_t yuv420Size(int width, int height) {
+    return width * height + 2 * ((width+1)/2) * ((height+1)/2);
+}
+
+YUV420Func yuv420Function() {
+#ifdef CPU_SIMD_X86
+    if(cpuKernelSupported(CPU_KERNEL_SSE42)) return rgbToYUV420SSE42;
+#endif
+    return rgbToYUV420Scalar;
+}
@@ -0,0 +1,53 @@
+/*
+    Copyright (C) 2010 Andrew Caudwell (acaudwell@gmail.com)
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version
+    3 of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef MANDELBULB_YUV420_H
+#define MANDELBULB_YUV420_H
+
+#include <stddef.h>
+
+// Conversion of packed RGB24 frames to planar YUV 4:2:0
+// (BT.601 limited range, chroma averaged over each 2x2 block).
+//
+// The source stride may be negative, so a frame read back from
+// OpenGL (bottom row first) can be converted the right way up by
+// passing a pointer to its last row.
+//
+// Output planes are tightly packed: Y is width x height, U and V
+// are (width+1)/2 x (height+1)/2.
+
+typedef void (*YUV420Func)(const unsigned char* rgb, ptrdiff_t stride, int width, int height,
+                           unsigned char* y, unsigned char* u, unsigned char* v);
+
+void rgbToYUV420Scalar(const unsigned char* rgb, ptrdiff_t stride, int width, int height,
+                       unsigned char* y, unsigned char* u, unsigned char* v);
+
+void rgbToYUV420SSE42(const unsigned char* rgb, ptrdiff_t stride, int width, int height,
+                      unsigned char* y, unsigned char* u, unsigned char* v);
+
+// convert a pair of rows from column x (which must be even) onwards.
+// row1 and y1 are the same as row0 and 0 for the last row of an odd height
+void yuv420Span(const unsigned char* row0, const unsigned char* row1, int x, int width,
+                unsigned char* y0, unsigned char* y1, unsigned char* u, unsigned char* v);
+
+// size in bytes of a converted frame
+size_t yuv420Size(int width, int height);
+
+// fastest conversion supported by this processor
+YUV420Func yuv420Function();
+
+#endif
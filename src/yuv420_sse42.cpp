@@ -0,0 +1,141 @@
+/*
+    Copyright (C) 2010 Andrew Caudwell (acaudwell@gmail.com)
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version
+    3 of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "yuv420.h"
+#include "cpu_simd.h"
+
+#ifdef CPU_SIMD_X86
+
+#include <immintrin.h>
+
+#pragma GCC push_options
+#pragma GCC target("sse4.2")
+
+namespace {
+
+// split 16 packed RGB pixels into one register per channel
+inline void deinterleave(const unsigned char* p, __m128i& r, __m128i& g, __m128i& b) {
+    __m128i a = _mm_loadu_si128((const __m128i*) p);
+    __m128i c = _mm_loadu_si128((const __m128i*) (p + 16));
+    __m128i d = _mm_loadu_si128((const __m128i*) (p + 32));
+
+    r = _mm_or_si128(_mm_or_si128(
+            _mm_shuffle_epi8(a, _mm_setr_epi8(0, 3, 6, 9, 12, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1)),
+            _mm_shuffle_epi8(c, _mm_setr_epi8(-1, -1, -1, -1, -1, -1, 2, 5, 8, 11, 14, -1, -1, -1, -1, -1))),
+            _mm_shuffle_epi8(d, _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 1, 4, 7, 10, 13)));
+
+    g = _mm_or_si128(_mm_or_si128(
+            _mm_shuffle_epi8(a, _mm_setr_epi8(1, 4, 7, 10, 13, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1)),
+            _mm_shuffle_epi8(c, _mm_setr_epi8(-1, -1, -1, -1, -1, 0, 3, 6, 9, 12, 15, -1, -1, -1, -1, -1))),
+            _mm_shuffle_epi8(d, _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 2, 5, 8, 11, 14)));
+
+    b = _mm_or_si128(_mm_or_si128(
+            _mm_shuffle_epi8(a, _mm_setr_epi8(2, 5, 8, 11, 14, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1)),
+            _mm_shuffle_epi8(c, _mm_setr_epi8(-1, -1, -1, -1, -1, 1, 4, 7, 10, 13, -1, -1, -1, -1, -1, -1))),
+            _mm_shuffle_epi8(d, _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 0, 3, 6, 9, 12, 15)));
+}
+
+// (66r + 129g + 25b + 128) >> 8 + 16 on 8 pixels widened to 16 bits
+inline __m128i luma(__m128i r, __m128i g, __m128i b) {
+    __m128i y = _mm_add_epi16(_mm_add_epi16(
+                    _mm_mullo_epi16(r, _mm_set1_epi16(66)),
+                    _mm_mullo_epi16(g, _mm_set1_epi16(129))),
+                    _mm_add_epi16(_mm_mullo_epi16(b, _mm_set1_epi16(25)), _mm_set1_epi16(128)));
+
+    return _mm_add_epi16(_mm_srli_epi16(y, 8), _mm_set1_epi16(16));
+}
+
+inline void storeLuma(unsigned char* dest, __m128i r, __m128i g, __m128i b) {
+    __m128i zero = _mm_setzero_si128();
+
+    __m128i lo = luma(_mm_unpacklo_epi8(r, zero), _mm_unpacklo_epi8(g, zero), _mm_unpacklo_epi8(b, zero));
+    __m128i hi = luma(_mm_unpackhi_epi8(r, zero), _mm_unpackhi_epi8(g, zero), _mm_unpackhi_epi8(b, zero));
+
+    _mm_storeu_si128((__m128i*) dest, _mm_packus_epi16(lo, hi));
+}
+
+// average of each 2x2 block of a channel over both rows, as 8 16 bit values
+inline __m128i average(__m128i c0, __m128i c1) {
+    __m128i rows = _mm_avg_epu8(c0, c1);
+
+    __m128i even = _mm_and_si128(rows, _mm_set1_epi16(0x00FF));
+    __m128i odd  = _mm_srli_epi16(rows, 8);
+
+    return _mm_avg_epu16(even, odd);
+}
+
+inline void storeChroma(unsigned char* dest, __m128i r, __m128i g, __m128i b, short kr, short kg, short kb) {
+    __m128i c = _mm_add_epi16(_mm_add_epi16(
+                    _mm_mullo_epi16(r, _mm_set1_epi16(kr)),
+                    _mm_mullo_epi16(g, _mm_set1_epi16(kg))),
+                    _mm_add_epi16(_mm_mullo_epi16(b, _mm_set1_epi16(kb)), _mm_set1_epi16(128)));
+
+    c = _mm_add_epi16(_mm_srai_epi16(c, 8), _mm_set1_epi16(128));
+
+    _mm_storel_epi64((__m128i*) dest, _mm_packus_epi16(c, c));
+}
+
+}
+
+void rgbToYUV420SSE42(const unsigned char* rgb, ptrdiff_t stride, int width, int height,
+                      unsigned char* y, unsigned char* u, unsigned char* v) {
+
+    int chroma_width = (width+1)/2;
+
+    //columns handled 16 at a time, the rest by the scalar code
+    int simd_width = width & ~15;
+
+    for(int j=0;j<height;j+=2) {
+
+        const unsigned char* row0 = rgb + j * stride;
+        unsigned char* y0 = y + j * width;
+        unsigned char* uj = u + (j/2) * chroma_width;
+        unsigned char* vj = v + (j/2) * chroma_width;
+
+        //last row of an odd height
+        if(j+1 >= height) {
+            yuv420Span(row0, row0, 0, width, y0, 0, uj, vj);
+            break;
+        }
+
+        const unsigned char* row1 = row0 + stride;
+        unsigned char* y1 = y0 + width;
+
+        for(int x=0;x<simd_width;x+=16) {
+            __m128i r0, g0, b0, r1, g1, b1;
+
+            deinterleave(row0 + x * 3, r0, g0, b0);
+            deinterleave(row1 + x * 3, r1, g1, b1);
+
+            storeLuma(y0 + x, r0, g0, b0);
+            storeLuma(y1 + x, r1, g1, b1);
+
+            __m128i r = average(r0, r1);
+            __m128i g = average(g0, g1);
+            __m128i b = average(b0, b1);
+
+            storeChroma(uj + x/2, r, g, b, -38, -74, 112);
+            storeChroma(vj + x/2, r, g, b, 112, -94, -18);
+        }
+
+        yuv420Span(row0, row1, simd_width, width, y0, y1, uj, vj);
+    }
+}
+
+#pragma GCC pop_options
+
+#endif